@@ -0,0 +1,80 @@
+// Compares the lookup of the builtin instructions in the perfect hash of interpreter.c with the
+// SipHash chained map that was used before.
+#include <stdio.h>
+#include <time.h>
+#include "../src/interpreter.h"
+#include "../src/builtins_hash.h"
+
+#define ROUNDS 200000
+#define MAP_SIZE 128
+#define HASHKEY0 0x734ad7e3439432a3ULL
+#define HASHKEY1 0x54dc762ab02dc4deULL
+
+struct OperationElem {
+    char *key;
+    operations op;
+    struct OperationElem *next;
+    size_t key_len;
+};
+
+static struct OperationElem *map[MAP_SIZE];
+
+static operations siphash_find(const char *key, size_t keylen){
+    size_t index = (size_t)(SipHash_2_4(HASHKEY0, HASHKEY1, key, keylen) & (MAP_SIZE - 1));
+    struct OperationElem *elem = map[index];
+    while (elem != NULL) {
+        if (strncmp(key, elem->key, keylen) == 0 && keylen == elem->key_len)
+            return elem->op;
+        elem = elem->next;
+    }
+    return NULL;
+}
+
+// names of the builtins followed by some words that are not builtins
+static char *keys[] = {
+        "int", "clear", "quote", "<=", "dup", "or", "swap", "+", "and", "dip",
+        "exit", "nop", "print", "size", "try", "%", "/", ">", "apply", "compose",
+        "drop", "empty", "if", "loop", "not", "pow", "printall", "roll", "sqrt", "top",
+        "xor", "!=", "*", "-", "<", "==", ">=", "true", "false", "split",
+        "sin", "cos", "exp", "--", "!", "gamma", "log", "log2", "log10", "arccosh",
+        "fib", "fill", "sumall", "cons", "take", "sip", "normal_d", "x", "counter", "pi"
+};
+#define KEYS_SIZE (sizeof(keys) / sizeof(keys[0]))
+
+int main(){
+    size_t keylen[KEYS_SIZE];
+    for (size_t i = 0; i < KEYS_SIZE; i++) {
+        keylen[i] = strlen(keys[i]);
+    }
+    for (size_t i = 0; i < OP_HASHED_SIZE; i++) {
+        struct OperationElem *elem = malloc(sizeof(struct OperationElem));
+        if (elem == NULL)
+            return -1;
+        size_t index = (size_t)(SipHash_2_4(HASHKEY0, HASHKEY1, INSTRUCTIONS[i], strlen(INSTRUCTIONS[i])) & (MAP_SIZE - 1));
+        elem->key = INSTRUCTIONS[i];
+        elem->key_len = strlen(INSTRUCTIONS[i]);
+        elem->op = INSTR_OP[i];
+        elem->next = map[index];
+        map[index] = elem;
+    }
+    size_t found = 0;
+    clock_t start = clock();
+    for (size_t r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < KEYS_SIZE; i++) {
+            found += siphash_find(keys[i], keylen[i]) != NULL;
+        }
+    }
+    double siphash = (double)(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    for (size_t r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < KEYS_SIZE; i++) {
+            found += find_op(keys[i], keylen[i]) != NULL;
+        }
+    }
+    double perfect = (double)(clock() - start) / CLOCKS_PER_SEC;
+    double lookups = (double)ROUNDS * KEYS_SIZE;
+    printf("builtin lookup (%zu found):\n", found);
+    printf("\tSipHash map:\t%.2f ns/lookup\n", siphash * 1e9 / lookups);
+    printf("\tperfect hash:\t%.2f ns/lookup\n", perfect * 1e9 / lookups);
+    return 0;
+}
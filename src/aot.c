@@ -0,0 +1,364 @@
+#include "aot.h"
+#include <inttypes.h>
+
+#define NAMED(fn) {fn, #fn}
+
+static const struct {
+    operations op;
+    const char *name;
+} OP_NAME[] = {
+    NAMED(op_int), NAMED(op_clear), NAMED(op_quote), NAMED(op_lowereq), NAMED(op_dup),
+    NAMED(op_or), NAMED(op_swap), NAMED(op_sum), NAMED(op_and), NAMED(op_dip),
+    NAMED(op_exit), NAMED(op_nop), NAMED(op_print), NAMED(op_size), NAMED(op_try),
+    NAMED(op_mod), NAMED(op_div), NAMED(op_greather), NAMED(op_apply), NAMED(op_compose),
+    NAMED(op_drop), NAMED(op_empty), NAMED(op_if), NAMED(op_loop), NAMED(op_not),
+    NAMED(op_pow), NAMED(op_printall), NAMED(op_roll), NAMED(op_sqrt), NAMED(op_top),
+    NAMED(op_xor), NAMED(op_notequal), NAMED(op_mul), NAMED(op_sub), NAMED(op_lower),
+    NAMED(op_equal), NAMED(op_greathereq), NAMED(op_true), NAMED(op_false), NAMED(op_split),
+    NAMED(op_stack), NAMED(op_push), NAMED(op_pop), NAMED(op_inject), NAMED(op_compress),
+    NAMED(op_none), NAMED(op_type), NAMED(op_INSTR), NAMED(op_INT), NAMED(op_FLOAT),
+    NAMED(op_BOOL), NAMED(op_STR), NAMED(op_TYPE), NAMED(op_NONE), NAMED(op_STACK),
+    NAMED(op_sin), NAMED(op_cos), NAMED(op_tan), NAMED(op_arcsin), NAMED(op_arccos),
+    NAMED(op_arctan), NAMED(op_sinh), NAMED(op_cosh), NAMED(op_tanh), NAMED(op_arcsinh),
+    NAMED(op_arccosh), NAMED(op_arctanh), NAMED(op_exp), NAMED(op_opposite), NAMED(op_factorial),
+    NAMED(op_gamma), NAMED(op_log), NAMED(op_log2), NAMED(op_log10)
+};
+#define OP_NAME_SIZE (sizeof(OP_NAME) / sizeof(OP_NAME[0]))
+
+static const struct {
+    br_operations brop;
+    const char *name;
+} BROP_NAME[] = {
+    NAMED(brop_load), NAMED(brop_if), NAMED(brop_save), NAMED(brop_compose),
+    NAMED(brop_delete), NAMED(brop_isdef), NAMED(brop_loop), NAMED(brop_split),
+    NAMED(brop_swap), NAMED(brop_define), NAMED(brop_dup), NAMED(brop_times), NAMED(brop_dig)
+};
+#define BROP_NAME_SIZE (sizeof(BROP_NAME) / sizeof(BROP_NAME[0]))
+
+static const struct {
+    num_operations numop;
+    const char *name;
+} NUMOP_NAME[] = {
+    NAMED(numop_dup), NAMED(numop_swap), NAMED(numop_dig), NAMED(numop_inject), NAMED(numop_pinject),
+    NAMED(numop_times)
+};
+#define NUMOP_NAME_SIZE (sizeof(NUMOP_NAME) / sizeof(NUMOP_NAME[0]))
+
+static const struct {
+    code_operations codeop;
+    const char *name;
+} CODEOP_NAME[] = {
+    NAMED(codeop_if), NAMED(codeop_loop), NAMED(codeop_times)
+};
+#define CODEOP_NAME_SIZE (sizeof(CODEOP_NAME) / sizeof(CODEOP_NAME[0]))
+
+// helpers of aot.h replacing the opcodes that the VM runs inline
+static const char *const INLINED_NAME[] = {
+    [OpSum] = "aot_sum", [OpSub] = "aot_sub", [OpMul] = "aot_mul",
+    [OpLower] = "aot_lower", [OpGreather] = "aot_greather", [OpLowerEq] = "aot_lowereq",
+    [OpGreatherEq] = "aot_greathereq", [OpEqual] = "aot_equal", [OpNotEqual] = "aot_notequal",
+    [OpAnd] = "aot_and", [OpOr] = "aot_or",
+    [OpSumImm] = "aot_sum_imm", [OpSubImm] = "aot_sub_imm", [OpMulImm] = "aot_mul_imm",
+    [OpLowerImm] = "aot_lower_imm", [OpGreatherImm] = "aot_greather_imm", [OpLowerEqImm] = "aot_lowereq_imm",
+    [OpGreatherEqImm] = "aot_greathereq_imm", [OpEqualImm] = "aot_equal_imm", [OpNotEqualImm] = "aot_notequal_imm",
+    [End] = NULL
+};
+
+static const char *op_Name(operations op){
+    for(size_t i = 0; i < OP_NAME_SIZE; i++){
+        if(OP_NAME[i].op == op)
+            return OP_NAME[i].name;
+    }
+    return NULL;
+}
+
+static const char *brop_Name(br_operations brop){
+    for(size_t i = 0; i < BROP_NAME_SIZE; i++){
+        if(BROP_NAME[i].brop == brop)
+            return BROP_NAME[i].name;
+    }
+    return NULL;
+}
+
+static const char *numop_Name(num_operations numop){
+    for(size_t i = 0; i < NUMOP_NAME_SIZE; i++){
+        if(NUMOP_NAME[i].numop == numop)
+            return NUMOP_NAME[i].name;
+    }
+    return NULL;
+}
+
+static const char *codeop_Name(code_operations codeop){
+    for(size_t i = 0; i < CODEOP_NAME_SIZE; i++){
+        if(CODEOP_NAME[i].codeop == codeop)
+            return CODEOP_NAME[i].name;
+    }
+    return NULL;
+}
+
+struct CodeList{
+    struct Code **codes;
+    size_t size;
+    size_t capacity;
+};
+
+// numbers the code and all the quotations it contains, the index is the name of the generated function
+static int collect_Codes(struct CodeList *list, struct Code *code){
+    if(list->size == list->capacity){
+        struct Code **newmem = realloc(list->codes, sizeof(struct Code *) * list->capacity * 2);
+        if(newmem == NULL)
+            return 0;
+        list->codes = newmem;
+        list->capacity *= 2;
+    }
+    list->codes[list->size] = code;
+    list->size += 1;
+    for(size_t i = 0; i < code->size; i++){
+        if(code->instrs[i].quote != NULL && !collect_Codes(list, code->instrs[i].quote))
+            return 0;
+    }
+    return 1;
+}
+
+static size_t code_Index(struct CodeList *list, struct Code *code){
+    size_t i = 0;
+    while(list->codes[i] != code)
+        i++;
+    return i;
+}
+
+static void emit_String(FILE *out, char *str, size_t len){
+    fputc('"', out);
+    for(size_t i = 0; i < len; i++){
+        unsigned char c = (unsigned char) str[i];
+        if(c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if(c == '\n')
+            fputs("\\n\"\n    \"", out);
+        else if(c < ' ' || c > '~')
+            fprintf(out, "\\%03o", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void emit_CInstr(FILE *out, struct CodeList *list, size_t index, struct Instr *instr){
+    struct Code *code = list->codes[index];
+    size_t off = instr->token.instr - code->src;
+    size_t argoff = off + instr->token.info.special.val + 1;
+    enum OpCode opcode = generic_OpCode(instr_OpCode(instr));
+    fprintf(out, "    AOT_AT(src_%zu, %zu);\n", index, off);
+    switch(opcode){
+        case PushInt:
+            fprintf(out, "    aot_push_int(state, INT64_C(%" PRId64 "), jbuff);\n", instr->token.info.integer);
+            break;
+        case PushFloat:
+            fprintf(out, "    aot_push_float(state, %a, jbuff);\n", instr->token.info.decimal);
+            break;
+        case PushBool:
+            fprintf(out, "    aot_push_bool(state, %" PRId64 ", jbuff);\n", instr->token.info.integer);
+            break;
+        case PushString:
+            fprintf(out, "    aot_push_text(state, String, src_%zu + %zu, %zu, NULL, jbuff);\n", index, off, instr->token.info.stringlen);
+            break;
+        case PushQuote:
+            fprintf(out, "    aot_push_text(state, Instruction, src_%zu + %zu, %zu, codes[%zu], jbuff);\n",
+                index, off, instr->token.info.stringlen, code_Index(list, instr->quote));
+            break;
+        case PushStack:
+            fprintf(out, "    aot_push_stack(state, codes[%zu], jbuff);\n", code_Index(list, instr->quote));
+            break;
+        case CallOp: case OpNot: case OpDup: case OpSwap: case OpDrop: case OpNop:
+            fprintf(out, "    %s(state, jbuff);\n", op_Name(instr->arg.op));
+            break;
+        case CallBrOp:
+            fprintf(out, "    %s(state, src_%zu + %zu, %zu, jbuff);\n", brop_Name(instr->arg.brop), index, argoff, instr->token.info.special.instrlen);
+            break;
+        case CallBrCode:
+            fprintf(out, "    execute_code(state, codes[%zu], jbuff);\n    AOT_AT(src_%zu, %zu);\n    %s(state, src_%zu + %zu, 0, jbuff);\n",
+                code_Index(list, instr->quote), index, off, brop_Name(instr->arg.brop), index, argoff);
+            break;
+        case CallBrNumOp:
+            if(instr->arg.brnum.brop == NULL){
+                fprintf(out, "    %s(state, %zu, jbuff);\n", numop_Name(instr->arg.brnum.numop), instr->arg.brnum.num);
+            }else{
+                fprintf(out, "    if(%zu < state->stack->next)\n        %s(state, %zu, jbuff);\n    else\n        %s(state, src_%zu + %zu, %zu, jbuff);\n",
+                    instr->arg.brnum.num, numop_Name(instr->arg.brnum.numop), instr->arg.brnum.num,
+                    brop_Name(instr->arg.brnum.brop), index, argoff, instr->token.info.special.instrlen);
+            }
+            break;
+        case CallCodeOp:
+            fprintf(out, "    %s(state, codes[%zu], jbuff);\n", codeop_Name(instr->arg.brcode.codeop), code_Index(list, instr->quote));
+            break;
+        case CallNumOp:
+            fprintf(out, "    %s(state, %zu, jbuff);\n", numop_Name(instr->arg.numop), instr->token.info.special.val);
+            break;
+        case RaiseError:
+            fprintf(out, "    RAISE(jbuff, %" PRId64 ");\n", instr->token.info.integer);
+            break;
+        case OpSum: case OpSub: case OpMul: case OpLower: case OpGreather: case OpLowerEq:
+        case OpGreatherEq: case OpEqual: case OpNotEqual: case OpAnd: case OpOr:
+            fprintf(out, "    %s(state, jbuff);\n", INLINED_NAME[opcode]);
+            break;
+        case OpSumImm: case OpSubImm: case OpMulImm: case OpLowerImm: case OpGreatherImm:
+        case OpLowerEqImm: case OpGreatherEqImm: case OpEqualImm: case OpNotEqualImm:
+            fprintf(out, "    AOT_AT(src_%zu, %zu);\n    %s(state, INT64_C(%" PRId64 "), jbuff);\n",
+                index, (size_t)(instr->arg.fused.lasttoken - code->src), INLINED_NAME[opcode], instr->arg.fused.imm);
+            break;
+        case OpSquare:
+            fprintf(out, "    op_dup(state, jbuff);\n    AOT_AT(src_%zu, %zu);\n    aot_mul(state, jbuff);\n",
+                index, (size_t)(instr->arg.fused.lasttoken - code->src));
+            break;
+        case OpSwapSub:
+            fprintf(out, "    op_swap(state, jbuff);\n    AOT_AT(src_%zu, %zu);\n    aot_sub(state, jbuff);\n",
+                index, (size_t)(instr->arg.fused.lasttoken - code->src));
+            break;
+        case OpSizeGreatherImm:
+            fprintf(out, "    aot_push_bool(state, (int64_t)state->stack->next > INT64_C(%" PRId64 "), jbuff);\n", instr->arg.fused.imm);
+            break;
+        case OpDupNMulImm:
+            fprintf(out, "    numop_dup(state, %zu, jbuff);\n    AOT_AT(src_%zu, %zu);\n    aot_mul_imm(state, INT64_C(%" PRId64 "), jbuff);\n",
+                instr->arg.fused.num, index, (size_t)(instr->arg.fused.lasttoken - code->src), instr->arg.fused.imm);
+            break;
+        case End:
+            break;
+        default:
+            UNREACHABLE;
+    }
+}
+
+// opcodes left to the VM by the generated functions, see native_Code
+static const char *const CALL_NAME[] = {
+    [CallWord] = "CallWord", [OpApply] = "OpApply", [OpIf] = "OpIf", [OpDip] = "OpDip", [End] = "End"
+};
+
+// index of the first call of code from start on, the one of its End if there's none
+static size_t next_Call(struct Code *code, size_t start){
+    while(start < code->size && !is_Call(instr_OpCode(&code->instrs[start])))
+        start += 1;
+    return start;
+}
+
+// the instructions of code index before every call become the function native_index_part, and
+// parts_index lists them with the calls
+static void emit_Code(FILE *out, struct CodeList *list, size_t index){
+    struct Code *code = list->codes[index];
+    size_t part = 0, end;
+    for(size_t start = 0; start <= code->size; start = end + 1, part++){
+        end = next_Call(code, start);
+        if(start == end)
+            continue;
+        fprintf(out, "\nstatic void native_%zu_%zu(struct ProgramState *state, struct ExceptionHandler *jbuff){\n", index, part);
+        for(size_t j = start; j < end; j++)
+            emit_CInstr(out, list, index, &code->instrs[j]);
+        fprintf(out, "}\n");
+    }
+    fprintf(out, "\nstatic const struct NativePart parts_%zu[] = {\n", index);
+    part = 0;
+    for(size_t start = 0; start <= code->size; start = end + 1, part++){
+        end = next_Call(code, start);
+        struct Instr *call = &code->instrs[end];
+        if(start < end)
+            fprintf(out, "    {native_%zu_%zu, ", index, part);
+        else
+            fprintf(out, "    {NULL, ");
+        fprintf(out, "%s, %zu, %zu},\n", CALL_NAME[generic_OpCode(instr_OpCode(call))], (size_t)(call->token.instr - code->src),
+            end < code->size ? call->token.info.stringlen : 0);
+    }
+    fprintf(out, "};\n");
+}
+
+static void emit_Program(FILE *out, struct CodeList *list, char *path){
+    fprintf(out, "// generated by sscript --emit-c from %s\n#include \"aot.h\"\n\n", path);
+    fprintf(out, "static struct Code *codes[%zu];\n\n", list->size);
+    for(size_t i = 0; i < list->size; i++){
+        fprintf(out, "static char src_%zu[] = ", i);
+        emit_String(out, list->codes[i]->src, list->codes[i]->srclen);
+        fprintf(out, ";\n");
+    }
+    for(size_t i = 0; i < list->size; i++)
+        emit_Code(out, list, i);
+    fprintf(out, "\nint main(void){\n");
+    for(size_t i = 0; i < list->size; i++){
+        fprintf(out, "    codes[%zu] = native_Code(src_%zu, sizeof(src_%zu) - 1, parts_%zu, sizeof(parts_%zu) / sizeof(parts_%zu[0]));\n",
+            i, i, i, i, i, i);
+        fprintf(out, "    if(codes[%zu] == NULL)\n        return -1;\n", i);
+    }
+    fprintf(out, "    return run_native(");
+    emit_String(out, path, strlen(path));
+    fprintf(out, ", codes, %zu);\n}\n", list->size);
+}
+
+int emit_C(FILE *out, char *path){
+    struct ExceptionHandler *jbuff = init_ExceptionHandler();
+    if(jbuff == NULL)
+        return -1;
+    jbuff->not_exec[0] = path;
+    struct Code *volatile code = NULL;
+    char *volatile content = NULL;
+    TRY(jbuff){
+        FILE *source = fopen(path, "r");
+        if(source == NULL)
+            RAISE(jbuff, FileNotFound);
+        fseek(source, 0, SEEK_END);
+        long flen = ftell(source);
+        if(flen < 0){
+            fclose(source);
+            RAISE(jbuff, IOError);
+        }
+        content = malloc(flen + 1);
+        if(content == NULL){
+            fclose(source);
+            RAISE(jbuff, ProgramPanic);
+        }
+        rewind(source);
+        size_t clen = fread(content, 1, flen, source);
+        fclose(source);
+        content[clen] = '\0';
+        code = compile_script(content, clen, jbuff);
+    }CATCHALL{
+        print_Exception(jbuff);
+        if(content != NULL)
+            free(content);
+        free_ExceptionHandler(jbuff);
+        return -1;
+    }
+    free(content);
+    free_ExceptionHandler(jbuff);
+    int res = 0;
+    struct CodeList list = {malloc(sizeof(struct Code *) * CODE_CAPACITY), 0, CODE_CAPACITY};
+    if(list.codes != NULL && collect_Codes(&list, code))
+        emit_Program(out, &list, path);
+    else
+        res = -1;
+    if(list.codes != NULL)
+        free(list.codes);
+    release_Code(code);
+    return res;
+}
+
+int run_native(char *path, struct Code **codes, size_t codes_num){
+    struct ProgramState state = init_PrgState(256, 256);
+    struct ExceptionHandler *jbuff = init_ExceptionHandler();
+    if(jbuff == NULL)
+        return -1;
+    jbuff->not_exec[0] = path;
+    int res = 0;
+    TRY(jbuff){
+        add_backtrace(jbuff);
+        execute_code(&state, codes[0], jbuff);
+        remove_backtrace(jbuff);
+    }CATCH(jbuff, ProgramExit){
+    }CATCHALL{
+        print_Exception(jbuff);
+        res = -1;
+    }
+    free_ExceptionHandler(jbuff);
+    free_PrgState(&state);
+    for(size_t i = 0; i < codes_num; i++)
+        release_Code(codes[i]);
+    free_Symbols();
+    print_allocated_mem();
+    return res;
+}
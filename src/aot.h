@@ -0,0 +1,103 @@
+#ifndef SSCRIPT_AOT_H
+#define SSCRIPT_AOT_H
+#include "compiler.h"
+
+// Ahead of time compilation: sscript --emit-c translates a script into a C file where the instructions
+// of every compiled code between two calls become a function calling the builtins directly, see native_Code.
+// The file is built against the interpreter objects (main.o excluded), the helpers below are the runtime
+// it relies on.
+
+int emit_C(FILE *out, char *path);
+
+int run_native(char *path, struct Code **codes, size_t codes_num);
+
+#define AOT_AT(src, off) jbuff->not_exec[jbuff->bt_size - 1] = (src) + (off)
+#define AOT_TOS(n) (state->stack->content[state->stack->next - (n)])
+
+static inline void aot_push_int(struct ProgramState *state, int64_t val, struct ExceptionHandler *jbuff){
+	struct StackElem elem;
+	elem.type = Integer;
+	elem.val.ival = val;
+	push_Stack(state->stack, elem, jbuff);
+}
+
+static inline void aot_push_bool(struct ProgramState *state, int64_t val, struct ExceptionHandler *jbuff){
+	struct StackElem elem;
+	elem.type = Boolean;
+	elem.val.ival = val;
+	push_Stack(state->stack, elem, jbuff);
+}
+
+static inline void aot_push_float(struct ProgramState *state, double val, struct ExceptionHandler *jbuff){
+	struct StackElem elem;
+	elem.type = Floating;
+	elem.val.fval = val;
+	push_Stack(state->stack, elem, jbuff);
+}
+
+static inline void aot_push_text(struct ProgramState *state, enum ElemType type, char *text, size_t len, struct Code *code, struct ExceptionHandler *jbuff){
+	struct StackElem elem;
+	elem.type = type;
+	if(!set_Text(&elem, text, len))
+		RAISE(jbuff, ProgramPanic);
+	elem.code = retain_Code(code);
+	push_Stack(state->stack, elem, jbuff);
+}
+
+static inline void aot_push_stack(struct ProgramState *state, struct Code *code, struct ExceptionHandler *jbuff){
+	struct StackElem elem = new_Stack(jbuff);
+	struct ProgramState sstat;
+	sstat.stack = elem.val.stack;
+	sstat.env = state->env;
+	add_backtrace(jbuff);
+	execute_code(&sstat, code, jbuff);
+	remove_backtrace(jbuff);
+	push_Stack(state->stack, elem, jbuff);
+}
+
+// same integer and boolean fast paths of the VM, the builtin is called for everything else
+#define AOT_BINARY(NAME, TYPE, RESTYPE, OPERATOR, FALLBACK) \
+static inline void NAME(struct ProgramState *state, struct ExceptionHandler *jbuff){ \
+	if(state->stack->next >= 2 && AOT_TOS(1).type == TYPE && AOT_TOS(2).type == TYPE){ \
+		AOT_TOS(2).val.ival = AOT_TOS(2).val.ival OPERATOR AOT_TOS(1).val.ival; \
+		AOT_TOS(2).type = RESTYPE; \
+		state->stack->next -= 1; \
+	}else{ \
+		FALLBACK(state, jbuff); \
+	} \
+}
+
+#define AOT_IMMEDIATE(NAME, RESTYPE, OPERATOR, FALLBACK) \
+static inline void NAME(struct ProgramState *state, int64_t imm, struct ExceptionHandler *jbuff){ \
+	if(state->stack->next >= 1 && AOT_TOS(1).type == Integer){ \
+		AOT_TOS(1).val.ival = AOT_TOS(1).val.ival OPERATOR imm; \
+		AOT_TOS(1).type = RESTYPE; \
+	}else{ \
+		aot_push_int(state, imm, jbuff); \
+		FALLBACK(state, jbuff); \
+	} \
+}
+
+AOT_BINARY(aot_sum, Integer, Integer, +, op_sum)
+AOT_BINARY(aot_sub, Integer, Integer, -, op_sub)
+AOT_BINARY(aot_mul, Integer, Integer, *, op_mul)
+AOT_BINARY(aot_lower, Integer, Boolean, <, op_lower)
+AOT_BINARY(aot_greather, Integer, Boolean, >, op_greather)
+AOT_BINARY(aot_lowereq, Integer, Boolean, <=, op_lowereq)
+AOT_BINARY(aot_greathereq, Integer, Boolean, >=, op_greathereq)
+AOT_BINARY(aot_equal, Integer, Boolean, ==, op_equal)
+AOT_BINARY(aot_notequal, Integer, Boolean, !=, op_notequal)
+AOT_BINARY(aot_and, Boolean, Boolean, &, op_and)
+AOT_BINARY(aot_or, Boolean, Boolean, |, op_or)
+
+AOT_IMMEDIATE(aot_sum_imm, Integer, +, op_sum)
+AOT_IMMEDIATE(aot_sub_imm, Integer, -, op_sub)
+AOT_IMMEDIATE(aot_mul_imm, Integer, *, op_mul)
+AOT_IMMEDIATE(aot_lower_imm, Boolean, <, op_lower)
+AOT_IMMEDIATE(aot_greather_imm, Boolean, >, op_greather)
+AOT_IMMEDIATE(aot_lowereq_imm, Boolean, <=, op_lowereq)
+AOT_IMMEDIATE(aot_greathereq_imm, Boolean, >=, op_greathereq)
+AOT_IMMEDIATE(aot_equal_imm, Boolean, ==, op_equal)
+AOT_IMMEDIATE(aot_notequal_imm, Boolean, !=, op_notequal)
+
+#endif
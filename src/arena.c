@@ -0,0 +1,54 @@
+#include "arena.h"
+#include <stdlib.h>
+#include "memdebug.h"
+
+#define ALIGN_UP(n) (((n) + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1))
+
+void *alloc_Arena(struct Arena *arena, size_t size){
+    size = ALIGN_UP(size);
+    struct ArenaBlock *block = arena->block;
+    if(block == NULL || block->size - block->used < size){
+        size_t blocksize = block == NULL ? ARENA_BLOCK_SIZE : block->size * 2;
+        while(blocksize < size)
+            blocksize *= 2;
+        block = malloc(sizeof(struct ArenaBlock) + blocksize);
+        if(block == NULL)
+            return NULL;
+        block->prev = arena->block;
+        block->size = blocksize;
+        block->used = 0;
+        arena->block = block;
+    }
+    void *res = block->data + block->used;
+    block->used += size;
+    return res;
+}
+
+void release_Arena(struct Arena *arena, struct ArenaMark mark){
+    if(arena->block == NULL)
+        return;
+    arena->block->used = arena->block == mark.block ? mark.used : 0;
+}
+
+void reset_Arena(struct Arena *arena){
+    if(arena->block == NULL)
+        return;
+    struct ArenaBlock *block = arena->block->prev;
+    while(block != NULL){
+        struct ArenaBlock *prev = block->prev;
+        free(block);
+        block = prev;
+    }
+    arena->block->prev = NULL;
+    arena->block->used = 0;
+}
+
+void free_Arena(struct Arena *arena){
+    struct ArenaBlock *block = arena->block;
+    while(block != NULL){
+        struct ArenaBlock *prev = block->prev;
+        free(block);
+        block = prev;
+    }
+    arena->block = NULL;
+}
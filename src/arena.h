@@ -0,0 +1,39 @@
+#ifndef SSCRIPT_ARENA_H
+#define SSCRIPT_ARENA_H
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE 4096
+
+// Bump allocator for the memory that doesn't outlive the evaluation of a line: nothing is freed on its
+// own, reset_Arena gives everything back at once and keeps the newest block for the next line.
+// A block twice as big as the previous one is chained when the current one is full.
+struct ArenaBlock{
+	struct ArenaBlock *prev;
+	size_t size;
+	size_t used;
+	_Alignas(max_align_t) char data[];
+};
+
+struct Arena{
+	struct ArenaBlock *block;
+};
+
+// what was allocated after a mark is given back by release_Arena, the blocks chained since
+// then are only emptied by the reset
+struct ArenaMark{
+	struct ArenaBlock *block;
+	size_t used;
+};
+
+// NULL when the memory can't be allocated
+void *alloc_Arena(struct Arena *arena, size_t size);
+void release_Arena(struct Arena *arena, struct ArenaMark mark);
+void reset_Arena(struct Arena *arena);
+void free_Arena(struct Arena *arena);
+
+static inline struct ArenaMark mark_Arena(const struct Arena *arena){
+	struct ArenaMark mark = {arena->block, arena->block != NULL ? arena->block->used : 0};
+	return mark;
+}
+
+#endif
@@ -22,6 +22,11 @@ void op_empty(struct ProgramState *state, struct ExceptionHandler *jbuff){
 }
 
 
+// texts of different length are told apart without reading them
+static inline int equal_Text(struct StackElem *t1, struct StackElem *t2){
+    return text_Len(t1) == text_Len(t2) && memcmp(text_Elem(t1), text_Elem(t2), text_Len(t1)) == 0;
+}
+
 static inline int equal_Stack(struct Stack *s1, struct Stack *s2){
     if(s1->next == s2->next){
             for(size_t i = 0; i < s1->next; i++){
@@ -30,7 +35,7 @@ static inline int equal_Stack(struct Stack *s1, struct Stack *s2){
                         switch(s1->content[i].type){
                             case String:
                             case Instruction:
-                                equals = (strcmp(s1->content[i].val.instr, s2->content[i].val.instr) == 0);
+                                equals = equal_Text(&s1->content[i], &s2->content[i]);
                                 break;
                             case Type:
                             case Boolean:
@@ -71,14 +76,15 @@ void op_equal(struct ProgramState *state, struct ExceptionHandler *jbuff){
     {
     case String:
         if(state->stack->content[resindex].type == String) {
-            result.val.ival = (strcmp(state->stack->content[state->stack->next].val.instr, state->stack->content[resindex].val.instr) == 0);
-            free(state->stack->content[state->stack->next].val.instr);
+            result.val.ival = equal_Text(&state->stack->content[state->stack->next], &state->stack->content[resindex]);
+            release_Text(&state->stack->content[state->stack->next]);
         }
         break;
     case Instruction:
         if(state->stack->content[resindex].type == Instruction) {
-            result.val.ival = (strcmp(state->stack->content[state->stack->next].val.instr, state->stack->content[resindex].val.instr) == 0);
-            free(state->stack->content[state->stack->next].val.instr);
+            result.val.ival = equal_Text(&state->stack->content[state->stack->next], &state->stack->content[resindex]);
+            release_Text(&state->stack->content[state->stack->next]);
+            release_Code(state->stack->content[state->stack->next].code);
         }
         break;
     case Integer:
@@ -111,7 +117,9 @@ void op_equal(struct ProgramState *state, struct ExceptionHandler *jbuff){
         UNREACHABLE;
     }
     if(state->stack->content[resindex].type == Instruction || state->stack->content[resindex].type == String){
-        free(state->stack->content[resindex].val.instr);
+        release_Text(&state->stack->content[resindex]);
+        if(state->stack->content[resindex].type == Instruction)
+            release_Code(state->stack->content[resindex].code);
     }else if(state->stack->content[resindex].type == InnerStack || state->stack->content[state->stack->next].type == InnerStack){
         state->stack->next += 1;
         push_Stack(state->stack, result, jbuff);
@@ -133,14 +141,15 @@ void op_notequal(struct ProgramState *state, struct ExceptionHandler *jbuff){
     {
     case String:
         if(state->stack->content[resindex].type == String) {
-            result.val.ival = (strcmp(state->stack->content[state->stack->next].val.instr, state->stack->content[resindex].val.instr) != 0);
-            free(state->stack->content[state->stack->next].val.instr);
+            result.val.ival = !equal_Text(&state->stack->content[state->stack->next], &state->stack->content[resindex]);
+            release_Text(&state->stack->content[state->stack->next]);
         }
         break;
     case Instruction:
         if(state->stack->content[resindex].type == Instruction) {
-           result.val.ival = (strcmp(state->stack->content[state->stack->next].val.instr, state->stack->content[resindex].val.instr) != 0);
-            free(state->stack->content[state->stack->next].val.instr);
+           result.val.ival = !equal_Text(&state->stack->content[state->stack->next], &state->stack->content[resindex]);
+            release_Text(&state->stack->content[state->stack->next]);
+            release_Code(state->stack->content[state->stack->next].code);
         }
         break;
     case Integer:
@@ -173,7 +182,9 @@ void op_notequal(struct ProgramState *state, struct ExceptionHandler *jbuff){
         UNREACHABLE;
     }
     if(state->stack->content[resindex].type == Instruction || state->stack->content[resindex].type == String){
-        free(state->stack->content[resindex].val.instr);
+        release_Text(&state->stack->content[resindex]);
+        if(state->stack->content[resindex].type == Instruction)
+            release_Code(state->stack->content[resindex].code);
     }else if(state->stack->content[resindex].type == InnerStack || state->stack->content[state->stack->next].type == InnerStack){
         state->stack->next += 1;
         push_Stack(state->stack, result, jbuff);
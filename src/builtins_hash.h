@@ -0,0 +1,54 @@
+// Generated by tools/gen_builtins_hash.py from the builtin tables of interpreter.c, do not edit.
+#ifndef SSCRIPT_BUILTINS_HASH_H
+#define SSCRIPT_BUILTINS_HASH_H
+
+#define OP_HASHED_SIZE 74
+#define OP_HASH_A 51u
+#define OP_HASH_B 237u
+#define OP_HASH_C 54u
+#define OP_HASH_D 73u
+#define OP_HASH_MASK 255u
+// index + 1 in INSTRUCTIONS of the key hashed in every slot, 0 if the slot is empty
+static const unsigned char OP_SLOT[256] = {
+        25,  3,  0,  0,  0,  0, 64, 15, 26, 39,  0, 24,  0,  0,  0, 29,
+        36,  0,  0, 17,  1,  0,  0,  0,  0,  0,  0, 48,  9, 18,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0, 12,  0,  0,  0,  0, 56,  0,  0,
+         0,  0, 46,  0,  0,  0,  0,  0,  0,  0, 50,  0,  0,  0, 47,  0,
+         0,  0,  0, 37, 63,  6,  0,  0,  0,  0,  0,  0,  0, 14,  0,  0,
+         0, 71,  0,  0, 49,  0,  0,  0,  0,  0, 30,  0,  0,  0,  0, 70,
+         0,  0,  0,  0,  0, 33,  0, 34,  0,  0, 13,  0, 74,  0,  0, 23,
+         0, 35, 54, 21, 52, 51,  0,  0,  0,  0,  7,  0, 32,  0, 53,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 43, 73,
+         0,  0, 31,  0,  0,  0,  0,  0,  0, 57, 44,  0, 10,  0, 28,  0,
+         0, 61,  0,  0,  0,  0, 67,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+        69,  0, 68,  2, 59, 41, 20, 16,  5, 65,  0,  8,  0,  0,  0,  0,
+         0,  0, 22,  0, 27,  0,  0,  0,  0,  0, 40,  0,  0, 45,  0,  0,
+         0,  0,  0, 62,  0,  0,  0,  0,  0,  0,  0, 42, 72,  4,  0, 38,
+         0,  0,  0,  0,  0,  0,  0,  0,  0, 66,  0,  0,  0,  0,  0,  0,
+        11,  0, 60,  0,  0, 55, 19,  0, 58,  0,  0,  0,  0,  0,  0,  0,
+};
+
+#define BROP_HASHED_SIZE 13
+#define BROP_HASH_A 9u
+#define BROP_HASH_B 4u
+#define BROP_HASH_C 23u
+#define BROP_HASH_D 8u
+#define BROP_HASH_MASK 31u
+// index + 1 in BRACKETS_INSTR of the key hashed in every slot, 0 if the slot is empty
+static const unsigned char BROP_SLOT[32] = {
+        11, 13,  0,  2,  0, 12,  4,  0,  0,  0,  0, 10,  1,  0,  0,  8,
+         0,  0,  0,  6,  0,  0,  3,  0,  7,  0,  0,  5,  0,  0,  0,  9,
+};
+
+#define NUMOP_HASHED_SIZE 5
+#define NUMOP_HASH_A 7u
+#define NUMOP_HASH_B 4u
+#define NUMOP_HASH_C 7u
+#define NUMOP_HASH_D 4u
+#define NUMOP_HASH_MASK 7u
+// index + 1 in NUMBERED_INSTR of the key hashed in every slot, 0 if the slot is empty
+static const unsigned char NUMOP_SLOT[8] = {
+         5,  2,  0,  0,  1,  3,  0,  4,
+};
+
+#endif //SSCRIPT_BUILTINS_HASH_H
@@ -0,0 +1,1248 @@
+#include "compiler.h"
+#include "infer.h"
+#include "jit.h"
+
+// code running the slice src of text, it takes the reference to text of the caller
+static struct Code *slice_Code(struct Text *text, char *src, size_t srclen){
+    struct Code *code = malloc(sizeof(struct Code));
+    if(code == NULL){
+        drop_Text(text);
+        return NULL;
+    }
+    code->src = src;
+    code->srclen = srclen;
+    code->text = text;
+    code->size = 0;
+    code->capacity = CODE_CAPACITY;
+    code->instrs = malloc(sizeof(struct Instr) * code->capacity);
+    if(code->instrs == NULL){
+        drop_Text(text);
+        free(code);
+        return NULL;
+    }
+    atomic_init(&code->refcount, 1);
+    atomic_init(&code->jit, NULL);
+    code->jitlen = 0;
+    code->jitsize = 0;
+    atomic_init(&code->hotness, 0);
+    return code;
+}
+
+// copy of clen characters of comands, ended by '\0' like the sources of parse_script
+static struct Text *source_Text(const char *comands, size_t clen){
+    struct Text *text = malloc(sizeof(struct Text) + clen + 1);
+    if(text == NULL)
+        return NULL;
+    atomic_init(&text->refcount, 1);
+    text->len = clen;
+    memcpy(text->data, comands, clen);
+    text->data[clen] = '\0';
+    return text;
+}
+
+struct Code *new_Code(char *comands, size_t clen){
+    struct Text *text = source_Text(comands, clen);
+    if(text == NULL)
+        return NULL;
+    return slice_Code(text, text->data, clen);
+}
+
+struct Code *retain_Code(struct Code *code){
+    if(code != NULL)
+        atomic_fetch_add_explicit(&code->refcount, 1, memory_order_relaxed);
+    return code;
+}
+
+void release_Code(struct Code *code){
+    if(code == NULL)
+        return;
+    if(atomic_fetch_sub_explicit(&code->refcount, 1, memory_order_acq_rel) != 1)
+        return;
+    for(size_t i = 0; i < code->size; i++){
+        release_Code(code->instrs[i].quote);
+    }
+    free_Jit(code);
+    free(code->instrs);
+    drop_Text(code->text);
+    free(code);
+}
+
+// one slot is always kept free for the End instruction closing the code
+static inline struct Instr *emit_Instr(struct Code *code, struct ExceptionHandler *jbuff){
+    if(code->size + 1 == code->capacity){
+        struct Instr *newmem = realloc(code->instrs, sizeof(struct Instr) * code->capacity * 2);
+        if(newmem == NULL)
+            RAISE(jbuff, ProgramPanic);
+        code->instrs = newmem;
+        code->capacity *= 2;
+    }
+    struct Instr *instr = &code->instrs[code->size];
+    instr->quote = NULL;
+    code->size += 1;
+    return instr;
+}
+
+static const struct {
+    operations op;
+    enum OpCode opcode;
+} INLINED_OP[] = {
+    {op_sum, OpSum}, {op_sub, OpSub}, {op_mul, OpMul},
+    {op_lower, OpLower}, {op_greather, OpGreather}, {op_lowereq, OpLowerEq}, {op_greathereq, OpGreatherEq},
+    {op_equal, OpEqual}, {op_notequal, OpNotEqual},
+    {op_not, OpNot}, {op_and, OpAnd}, {op_or, OpOr},
+    {op_dup, OpDup}, {op_swap, OpSwap}, {op_drop, OpDrop}, {op_nop, OpNop},
+    {op_apply, OpApply}, {op_if, OpIf}, {op_dip, OpDip}
+};
+#define INLINED_SIZE (sizeof(INLINED_OP) / sizeof(INLINED_OP[0]))
+
+static inline enum OpCode op_OpCode(operations op){
+    for(size_t i = 0; i < INLINED_SIZE; i++){
+        if(INLINED_OP[i].op == op)
+            return INLINED_OP[i].opcode;
+    }
+    return CallOp;
+}
+
+static inline void resolve_Instr(struct Instr *instr){
+    switch(instr->token.type){
+        case StringToken:
+            instr->opcode = PushString;
+            break;
+        case InstrToken:
+            instr->opcode = PushQuote;
+            break;
+        case StackToken:
+            instr->opcode = PushStack;
+            break;
+        case IntegerToken:
+            instr->opcode = PushInt;
+            break;
+        case DecimalToken:
+            instr->opcode = PushFloat;
+            break;
+        case GenericToken:
+            instr->arg.op = find_op(instr->token.instr, instr->token.info.stringlen);
+            if(instr->arg.op == op_true || instr->arg.op == op_false){
+                instr->opcode = PushBool;
+                instr->token.info.integer = instr->arg.op == op_true;
+            }else{
+                instr->opcode = instr->arg.op != NULL ? op_OpCode(instr->arg.op) : CallWord;
+            }
+            break;
+        case BrInstrToken:
+            instr->arg.brop = find_brop(instr->token.instr, instr->token.info.special.val);
+            instr->opcode = instr->arg.brop != NULL ? CallBrOp : CallWord;
+            break;
+        case NumInsrtToken:
+            instr->arg.numop = find_numop(instr->token.instr, instr->token.info.special.instrlen);
+            if(instr->arg.numop != NULL){
+                instr->opcode = CallNumOp;
+            }else{
+                instr->opcode = RaiseError;
+                instr->token.type = ErrorToken;
+                instr->token.info.integer = InvalidInstruction;
+            }
+            break;
+        case ErrorToken:
+            instr->opcode = RaiseError;
+            break;
+        default:
+            UNREACHABLE;
+    }
+    if(instr->opcode == CallWord){
+        atomic_init(&instr->arg.word.code, NULL);
+        atomic_init(&instr->arg.word.generation, 0);
+    }
+}
+
+// Superinstructions: when the last two instructions match a rule they are replaced by the fused one.
+// A fused instruction can be the second one of another rule, so triples are built a pair at a time.
+static const struct {
+    enum OpCode first;
+    enum OpCode second;
+    enum OpCode fused;
+    const char *pattern;
+} FUSION_RULE[] = {
+    {PushInt, OpSum, OpSumImm, "<int> +"},
+    {PushInt, OpSub, OpSubImm, "<int> -"},
+    {PushInt, OpMul, OpMulImm, "<int> *"},
+    {PushInt, OpLower, OpLowerImm, "<int> <"},
+    {PushInt, OpGreather, OpGreatherImm, "<int> >"},
+    {PushInt, OpLowerEq, OpLowerEqImm, "<int> <="},
+    {PushInt, OpGreatherEq, OpGreatherEqImm, "<int> >="},
+    {PushInt, OpEqual, OpEqualImm, "<int> =="},
+    {PushInt, OpNotEqual, OpNotEqualImm, "<int> !="},
+    {OpDup, OpMul, OpSquare, "dup *"},
+    {OpSwap, OpSub, OpSwapSub, "swap -"},
+    {CallOp, OpGreatherImm, OpSizeGreatherImm, "size <int> >"},
+    {CallNumOp, OpMulImm, OpDupNMulImm, "dup<n> <int> *"}
+};
+#define FUSION_SIZE (sizeof(FUSION_RULE) / sizeof(FUSION_RULE[0]))
+
+static atomic_size_t fusion_count[FUSION_SIZE];
+
+static inline int match_Fusion(size_t rule, struct Instr *first, struct Instr *second){
+    if(FUSION_RULE[rule].first != first->opcode || FUSION_RULE[rule].second != second->opcode)
+        return 0;
+    if(first->opcode == CallOp)
+        return first->arg.op == op_size;
+    if(first->opcode == CallNumOp)
+        return first->arg.numop == numop_dup;
+    return 1;
+}
+
+static atomic_size_t folded_count;
+static atomic_size_t nop_count;
+
+// evaluates at compile time the operations whose operands are all constants
+static inline int fold_Constants(struct Code *code){
+    struct Instr *last = &code->instrs[code->size - 1];
+    struct Instr *prev = &code->instrs[code->size - 2];
+    if(prev->opcode == PushInt && last->opcode >= OpSumImm && last->opcode <= OpNotEqualImm){
+        int64_t a = prev->token.info.integer;
+        int64_t b = last->arg.fused.imm;
+        prev->opcode = PushBool;
+        switch(last->opcode){
+            case OpSumImm:
+                prev->opcode = PushInt;
+                a = a + b;
+                break;
+            case OpSubImm:
+                prev->opcode = PushInt;
+                a = a - b;
+                break;
+            case OpMulImm:
+                prev->opcode = PushInt;
+                a = a * b;
+                break;
+            case OpLowerImm:
+                a = a < b;
+                break;
+            case OpGreatherImm:
+                a = a > b;
+                break;
+            case OpLowerEqImm:
+                a = a <= b;
+                break;
+            case OpGreatherEqImm:
+                a = a >= b;
+                break;
+            case OpEqualImm:
+                a = a == b;
+                break;
+            case OpNotEqualImm:
+                a = a != b;
+                break;
+            default:
+                UNREACHABLE;
+        }
+        prev->token.info.integer = a;
+    }else if(prev->opcode == PushBool && last->opcode == OpNot){
+        prev->token.info.integer = ! prev->token.info.integer;
+    }else if(code->size >= 3 && code->instrs[code->size - 3].opcode == PushBool && prev->opcode == PushBool
+            && (last->opcode == OpAnd || last->opcode == OpOr)){
+        struct Instr *first = &code->instrs[code->size - 3];
+        if(last->opcode == OpAnd)
+            first->token.info.integer = first->token.info.integer & prev->token.info.integer;
+        else
+            first->token.info.integer = first->token.info.integer | prev->token.info.integer;
+        code->size -= 1;
+    }else{
+        return 0;
+    }
+    code->size -= 1;
+    atomic_fetch_add_explicit(&folded_count, 1, memory_order_relaxed);
+    return 1;
+}
+
+// peephole pass on the last emitted instructions: removes nop, folds constants and fuses superinstructions
+static inline void optimize_Tail(struct Code *code){
+    if(code->size >= 1 && code->instrs[code->size - 1].opcode == OpNop){
+        code->size -= 1;
+        atomic_fetch_add_explicit(&nop_count, 1, memory_order_relaxed);
+        return;
+    }
+    size_t rule = 0;
+    while(code->size >= 2 && rule < FUSION_SIZE){
+        if(fold_Constants(code)){
+            rule = 0;
+            continue;
+        }
+        struct Instr *first = &code->instrs[code->size - 2];
+        struct Instr *second = &code->instrs[code->size - 1];
+        if(!match_Fusion(rule, first, second)){
+            rule += 1;
+            continue;
+        }
+        struct FusedArg fused;
+        if(second->opcode >= OpSumImm){
+            fused = second->arg.fused;
+        }else{
+            fused.lasttoken = second->token.instr;
+        }
+        if(first->opcode == PushInt)
+            fused.imm = first->token.info.integer;
+        else if(first->opcode == CallNumOp)
+            fused.num = first->token.info.special.val;
+        first->opcode = FUSION_RULE[rule].fused;
+        first->arg.fused = fused;
+        code->size -= 1;
+        atomic_fetch_add_explicit(&fusion_count[rule], 1, memory_order_relaxed);
+        rule = 0;
+    }
+}
+
+// The argument of these bracket instructions is executed before anything else, so it is compiled
+// once and run by CallBrCode, that then calls the bracket instruction on an empty argument.
+static const br_operations EAGER_BROP[] = {
+    brop_dup, brop_swap, brop_dig, brop_split, brop_compose
+};
+#define EAGER_SIZE (sizeof(EAGER_BROP) / sizeof(EAGER_BROP[0]))
+
+static const struct {
+    br_operations brop;
+    num_operations numop;
+} BRACKET_NUMOP[] = {
+    {brop_dup, numop_dup}, {brop_swap, numop_swap}, {brop_dig, numop_dig}
+};
+#define BRACKET_NUMOP_SIZE (sizeof(BRACKET_NUMOP) / sizeof(BRACKET_NUMOP[0]))
+
+// The argument of these bracket instructions is run only after their operands are popped, and by
+// loop at every iteration: it is compiled once and CallCodeOp passes it to the codeop.
+static const struct {
+    br_operations brop;
+    code_operations codeop;
+} BRACKET_CODEOP[] = {
+    {brop_times, codeop_times}, {brop_if, codeop_if}, {brop_loop, codeop_loop}
+};
+#define BRACKET_CODEOP_SIZE (sizeof(BRACKET_CODEOP) / sizeof(BRACKET_CODEOP[0]))
+
+code_operations bracket_CodeOp(br_operations brop){
+    for(size_t i = 0; i < BRACKET_CODEOP_SIZE; i++){
+        if(BRACKET_CODEOP[i].brop == brop)
+            return BRACKET_CODEOP[i].codeop;
+    }
+    return NULL;
+}
+
+static struct Code *compile_Source(struct Text *text, char *comands, size_t clen, const struct SourceIndex *index, struct ExceptionHandler *jbuff);
+
+static inline void compile_BrArg(struct Instr *instr, struct Text *text, const struct SourceIndex *index, struct ExceptionHandler *jbuff){
+    br_operations brop = instr->arg.brop;
+    code_operations codeop = bracket_CodeOp(brop);
+    size_t i = 0;
+    while(i < EAGER_SIZE && EAGER_BROP[i] != brop)
+        i++;
+    if(i == EAGER_SIZE && codeop == NULL)
+        return;
+    size_t argoff = instr->token.info.special.val + 1;
+    struct SourceIndex argindex = slice_Index(index, argoff);
+    struct Code *arg = compile_Source(text, instr->token.instr + argoff, instr->token.info.special.instrlen, &argindex, jbuff);
+    if(arg->size == 1 && arg->instrs[0].opcode == PushInt && arg->instrs[0].token.info.integer >= 0){
+        size_t num = (size_t) arg->instrs[0].token.info.integer;
+        if(brop == brop_times){
+            release_Code(arg);
+            instr->opcode = CallBrNumOp;
+            instr->arg.brnum.numop = numop_times;
+            instr->arg.brnum.num = num;
+            instr->arg.brnum.brop = NULL;
+            return;
+        }
+        for(size_t j = 0; j < BRACKET_NUMOP_SIZE; j++){
+            if(BRACKET_NUMOP[j].brop == brop){
+                release_Code(arg);
+                instr->opcode = CallBrNumOp;
+                instr->arg.brnum.numop = BRACKET_NUMOP[j].numop;
+                instr->arg.brnum.num = num;
+                instr->arg.brnum.brop = BRACKET_NUMOP[j].brop;
+                return;
+            }
+        }
+        // split(<int>) and compose(<int>) keep the argument text, it's a single push anyway
+        if(codeop == NULL){
+            release_Code(arg);
+            return;
+        }
+    }
+    if(codeop != NULL){
+        instr->opcode = CallCodeOp;
+        instr->arg.brcode.brop = brop;
+        instr->arg.brcode.codeop = codeop;
+    }else{
+        instr->opcode = CallBrCode;
+    }
+    instr->quote = arg;
+}
+
+void print_fusions(){
+    printf("Superinstructions fused:\npattern\t\t\tcount\n");
+    for(size_t i = 0; i < FUSION_SIZE; i++){
+        printf("%-16s\t%zu\n", FUSION_RULE[i].pattern, atomic_load(&fusion_count[i]));
+    }
+    printf("constants folded\t%zu\nnop removed\t\t%zu\n", atomic_load(&folded_count), atomic_load(&nop_count));
+    print_inference();
+}
+
+// Tokenizing errors are not raised here: they are compiled into an ErrorToken so that they
+// are raised only when (and if) the execution reaches them, like parse_script does.
+// comands is a slice of text and index is the slice of its index starting at comands, the
+// quotations and the bracket arguments are compiled with their slices of the same text and index.
+static struct Code *compile_Source(struct Text *text, char *comands, size_t clen, const struct SourceIndex *index, struct ExceptionHandler *jbuff){
+    struct Code *code = slice_Code(retain_Text(text), comands, clen);
+    if(code == NULL)
+        RAISE(jbuff, ProgramPanic);
+    struct ExceptionHandler comperr;
+    volatile size_t start = 0;
+    TRY(&comperr){
+        struct Token token;
+        size_t i = 0;
+        while(1){
+            start = i;
+            if(!next_token(code->src, clen, &i, &token, index, &comperr))
+                break;
+            struct Instr *instr = emit_Instr(code, &comperr);
+            instr->token = token;
+            resolve_Instr(instr);
+            struct SourceIndex tokenindex = slice_Index(index, token.instr - code->src);
+            if(token.type == InstrToken || token.type == StackToken)
+                instr->quote = compile_Source(text, token.instr, token.info.stringlen, &tokenindex, &comperr);
+            else if(instr->opcode == CallBrOp)
+                compile_BrArg(instr, text, &tokenindex, &comperr);
+            else if(instr->opcode == CallWord && (instr->arg.word.symbol = intern_Symbol(token.instr, token.info.stringlen)) == SYMBOL_ERROR)
+                RAISE(&comperr, ProgramPanic);
+            optimize_Tail(code);
+        }
+    }CATCH(&comperr, ProgramPanic){
+        release_Code(code);
+        RAISE(jbuff, ProgramPanic);
+    }CATCHALL{
+        uint32_t error = comperr.exit_value;
+        size_t errpos = start;
+        while(errpos < clen && IS_INDENT(code->src[errpos]))
+            errpos += 1;
+        TRY(&comperr){
+            struct Instr *instr = emit_Instr(code, &comperr);
+            instr->opcode = RaiseError;
+            instr->token.type = ErrorToken;
+            instr->token.instr = code->src + errpos;
+            instr->token.info.integer = error;
+        }CATCHALL{
+            release_Code(code);
+            RAISE(jbuff, ProgramPanic);
+        }
+    }
+    struct Instr *end = &code->instrs[code->size];
+    end->opcode = End;
+    end->token.type = ErrorToken;
+    end->token.instr = code->src + clen;
+    end->quote = NULL;
+    infer_Code(code);
+    return code;
+}
+
+struct Code *compile_script(char *comands, size_t clen, struct ExceptionHandler *jbuff){
+    struct Text *text = source_Text(comands, clen);
+    if(text == NULL)
+        RAISE(jbuff, ProgramPanic);
+    struct SourceIndex index = index_Source(text->data, clen);
+    if(index.match == NULL){
+        drop_Text(text);
+        RAISE(jbuff, ProgramPanic);
+    }
+    struct ExceptionHandler indexerr;
+    struct Code *volatile code = NULL;
+    TRY(&indexerr){
+        code = compile_Source(text, text->data, clen, &index, &indexerr);
+    }CATCHALL{
+        free_SourceIndex(&index);
+        drop_Text(text);
+        RAISE(jbuff, indexerr.exit_value);
+    }
+    free_SourceIndex(&index);
+    drop_Text(text);
+    return code;
+}
+
+// code running the functions generated by --emit-c in turn, with the calls between them left to the VM:
+// they use its frames, so deep recursion doesn't grow the C stack and a call before End is a tail call
+struct Code *native_Code(char *src, size_t srclen, const struct NativePart *parts, size_t num){
+    struct Code *code = new_Code(src, srclen);
+    if(code == NULL)
+        return NULL;
+    if(2 * num > code->capacity){
+        struct Instr *newmem = realloc(code->instrs, sizeof(struct Instr) * 2 * num);
+        if(newmem == NULL){
+            release_Code(code);
+            return NULL;
+        }
+        code->instrs = newmem;
+        code->capacity = 2 * num;
+    }
+    for(size_t i = 0; i < num; i++){
+        struct Instr *instr;
+        if(parts[i].fn != NULL){
+            instr = &code->instrs[code->size];
+            instr->opcode = CallOp;
+            instr->arg.op = parts[i].fn;
+            instr->token.type = GenericToken;
+            instr->token.instr = code->src + (i == 0 ? 0 : parts[i - 1].off);
+            instr->quote = NULL;
+            code->size += 1;
+        }
+        instr = &code->instrs[code->size];
+        instr->opcode = parts[i].opcode;
+        instr->token.type = parts[i].opcode == End ? ErrorToken : GenericToken;
+        instr->token.instr = code->src + parts[i].off;
+        instr->token.info.stringlen = parts[i].len;
+        instr->quote = NULL;
+        if(parts[i].opcode == End)
+            break;
+        code->size += 1;
+        if(parts[i].opcode == CallWord){
+            atomic_init(&instr->arg.word.code, NULL);
+            atomic_init(&instr->arg.word.generation, 0);
+            if((instr->arg.word.symbol = intern_Symbol(instr->token.instr, parts[i].len)) == SYMBOL_ERROR){
+                release_Code(code);
+                return NULL;
+            }
+        }
+    }
+    return code;
+}
+
+// With GCC the instructions are dispatched with labels as values: every handler jumps directly
+// to the next one. Build with -DSSCRIPT_SWITCH_DISPATCH (make DISPATCH=switch) to use a plain switch.
+#if defined(__GNUC__) && !defined(SSCRIPT_SWITCH_DISPATCH)
+#define THREADED_DISPATCH
+#endif
+
+#ifdef THREADED_DISPATCH
+#define TARGET(opcode) TARGET_##opcode
+#define DISPATCH() goto *dispatch_table[instr_OpCode(instr)]
+#else
+#define TARGET(opcode) case opcode
+#define DISPATCH() continue
+#endif
+
+#define NEXT() instr += 1; DISPATCH()
+#define SET_NOT_EXEC() jbuff->not_exec[jbuff->bt_size - 1] = instr->token.instr
+
+// The top of the stack is kept in registers: sp points past the top element, bottom to the first one
+// and limit to the slot push_Stack always leaves free. stack->next is written by SPILL only before
+// an op that isn't inlined, a call or an exception, and the registers are read back by RELOAD after it.
+#define TOS(n) (sp[-(n)])
+#define DEPTH() ((size_t) (sp - bottom))
+#define HAS_ELEMS(n) (sp >= bottom + (n))
+#define SPILL() stack->next = DEPTH()
+#define RELOAD() bottom = stack->content; sp = bottom + stack->next; limit = bottom + stack->capacity - 1
+#define PUSH(value) \
+    if(sp < limit){ \
+        *sp = (value); \
+        sp += 1; \
+    }else{ \
+        SPILL(); \
+        push_Stack(stack, (value), jbuff); \
+        RELOAD(); \
+    }
+#define IS_SCALAR(type) ((type) == Integer || (type) == Floating || (type) == Boolean || (type) == Type || (type) == None)
+
+#define FLOAT_OPERANDS(n) (HAS_ELEMS(n) && TOS(1).type == Floating && ((n) == 1 || TOS(2).type == Floating))
+
+// Quickening: the generic arithmetic and comparisons run integers inline, on floating operands they
+// rewrite the instruction to its floating version, that rewrites it back when its operands change
+#define INT_BINARY(OPERATOR, FALLBACK, QUICKENED) \
+    if(HAS_ELEMS(2) && TOS(1).type == Integer && TOS(2).type == Integer){ \
+        TOS(2).val.ival = TOS(2).val.ival OPERATOR TOS(1).val.ival; \
+        sp -= 1; \
+    }else if(FLOAT_OPERANDS(2)){ \
+        quicken_Instr(instr, QUICKENED); \
+        DISPATCH(); \
+    }else{ \
+        SET_NOT_EXEC(); \
+        SPILL(); \
+        FALLBACK(state, jbuff); \
+        RELOAD(); \
+    } \
+    NEXT()
+
+#define INT_COMPARE(OPERATOR, FALLBACK, QUICKENED) \
+    if(HAS_ELEMS(2) && TOS(1).type == Integer && TOS(2).type == Integer){ \
+        TOS(2).val.ival = TOS(2).val.ival OPERATOR TOS(1).val.ival; \
+        TOS(2).type = Boolean; \
+        sp -= 1; \
+    }else if(FLOAT_OPERANDS(2)){ \
+        quicken_Instr(instr, QUICKENED); \
+        DISPATCH(); \
+    }else{ \
+        SET_NOT_EXEC(); \
+        SPILL(); \
+        FALLBACK(state, jbuff); \
+        RELOAD(); \
+    } \
+    NEXT()
+
+#define BOOL_BINARY(OPERATOR, FALLBACK) \
+    if(HAS_ELEMS(2) && TOS(1).type == Boolean && TOS(2).type == Boolean){ \
+        TOS(2).val.ival = TOS(2).val.ival OPERATOR TOS(1).val.ival; \
+        sp -= 1; \
+    }else{ \
+        SET_NOT_EXEC(); \
+        SPILL(); \
+        FALLBACK(state, jbuff); \
+        RELOAD(); \
+    } \
+    NEXT()
+
+#define SET_NOT_EXEC_LAST() jbuff->not_exec[jbuff->bt_size - 1] = instr->arg.fused.lasttoken
+
+#define PUSH_IMM() \
+    elem.type = Integer; \
+    elem.val.ival = instr->arg.fused.imm; \
+    push_Stack(stack, elem, jbuff)
+
+#define INT_IMMEDIATE(OPERATOR, FALLBACK, QUICKENED) \
+    if(HAS_ELEMS(1) && TOS(1).type == Integer){ \
+        TOS(1).val.ival = TOS(1).val.ival OPERATOR instr->arg.fused.imm; \
+    }else if(FLOAT_OPERANDS(1)){ \
+        quicken_Instr(instr, QUICKENED); \
+        DISPATCH(); \
+    }else{ \
+        SET_NOT_EXEC_LAST(); \
+        SPILL(); \
+        PUSH_IMM(); \
+        FALLBACK(state, jbuff); \
+        RELOAD(); \
+    } \
+    NEXT()
+
+#define INT_COMPARE_IMMEDIATE(OPERATOR, FALLBACK, QUICKENED) \
+    if(HAS_ELEMS(1) && TOS(1).type == Integer){ \
+        TOS(1).val.ival = TOS(1).val.ival OPERATOR instr->arg.fused.imm; \
+        TOS(1).type = Boolean; \
+    }else if(FLOAT_OPERANDS(1)){ \
+        quicken_Instr(instr, QUICKENED); \
+        DISPATCH(); \
+    }else{ \
+        SET_NOT_EXEC_LAST(); \
+        SPILL(); \
+        PUSH_IMM(); \
+        FALLBACK(state, jbuff); \
+        RELOAD(); \
+    } \
+    NEXT()
+
+#define FLOAT_BINARY(OPERATOR, GENERIC) \
+    if(FLOAT_OPERANDS(2)){ \
+        TOS(2).val.fval = TOS(2).val.fval OPERATOR TOS(1).val.fval; \
+        sp -= 1; \
+        NEXT(); \
+    } \
+    quicken_Instr(instr, GENERIC); \
+    DISPATCH()
+
+#define FLOAT_COMPARE(OPERATOR, GENERIC) \
+    if(FLOAT_OPERANDS(2)){ \
+        TOS(2).val.ival = TOS(2).val.fval OPERATOR TOS(1).val.fval; \
+        TOS(2).type = Boolean; \
+        sp -= 1; \
+        NEXT(); \
+    } \
+    quicken_Instr(instr, GENERIC); \
+    DISPATCH()
+
+#define FLOAT_IMMEDIATE(OPERATOR, GENERIC) \
+    if(FLOAT_OPERANDS(1)){ \
+        TOS(1).val.fval = TOS(1).val.fval OPERATOR (double) instr->arg.fused.imm; \
+        NEXT(); \
+    } \
+    quicken_Instr(instr, GENERIC); \
+    DISPATCH()
+
+#define FLOAT_COMPARE_IMMEDIATE(OPERATOR, GENERIC) \
+    if(FLOAT_OPERANDS(1)){ \
+        TOS(1).val.ival = TOS(1).val.fval OPERATOR (double) instr->arg.fused.imm; \
+        TOS(1).type = Boolean; \
+        NEXT(); \
+    } \
+    quicken_Instr(instr, GENERIC); \
+    DISPATCH()
+
+// the operands of the unchecked opcodes have been proven by infer_Code
+#define INT_BINARY_UNCHECKED(OPERATOR) \
+    TOS(2).val.ival = TOS(2).val.ival OPERATOR TOS(1).val.ival; \
+    sp -= 1; \
+    NEXT()
+
+#define INT_COMPARE_UNCHECKED(OPERATOR) \
+    TOS(2).val.ival = TOS(2).val.ival OPERATOR TOS(1).val.ival; \
+    TOS(2).type = Boolean; \
+    sp -= 1; \
+    NEXT()
+
+#define INT_COMPARE_IMMEDIATE_UNCHECKED(OPERATOR) \
+    TOS(1).val.ival = TOS(1).val.ival OPERATOR instr->arg.fused.imm; \
+    TOS(1).type = Boolean; \
+    NEXT()
+
+// Counts the times code is entered and once it's hot runs its machine code, the VM goes on from the returned
+// instruction. Only one thread gets the count to JIT_THRESHOLD, the count stops there so it can't wrap around.
+static inline struct Instr *enter_Code(struct ProgramState *state, struct Code *code, struct ExceptionHandler *jbuff){
+    operations jit = atomic_load_explicit(&code->jit, memory_order_acquire);
+    if(jit == NULL){
+        if(!jit_enabled || atomic_load_explicit(&code->hotness, memory_order_relaxed) >= JIT_THRESHOLD
+            || atomic_fetch_add_explicit(&code->hotness, 1, memory_order_relaxed) + 1 != JIT_THRESHOLD)
+            return code->instrs;
+        jit_Code(code);
+        jit = atomic_load_explicit(&code->jit, memory_order_relaxed);
+        if(jit == NULL)
+            return code->instrs;
+    }
+    jit(state, jbuff);
+    return code->instrs + code->jitlen;
+}
+
+#ifdef THREADED_DISPATCH
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+void execute_code(struct ProgramState *state, struct Code *code, struct ExceptionHandler *jbuff){
+#ifdef THREADED_DISPATCH
+    static void *const dispatch_table[] = {
+        [PushInt] = &&TARGET_PushInt, [PushFloat] = &&TARGET_PushFloat, [PushString] = &&TARGET_PushString,
+        [PushBool] = &&TARGET_PushBool,
+        [PushQuote] = &&TARGET_PushQuote, [PushStack] = &&TARGET_PushStack,
+        [CallOp] = &&TARGET_CallOp, [CallBrOp] = &&TARGET_CallBrOp,
+        [CallBrCode] = &&TARGET_CallBrCode, [CallBrNumOp] = &&TARGET_CallBrNumOp,
+        [CallCodeOp] = &&TARGET_CallCodeOp, [CallNumOp] = &&TARGET_CallNumOp,
+        [CallWord] = &&TARGET_CallWord, [RaiseError] = &&TARGET_RaiseError,
+        [OpSum] = &&TARGET_OpSum, [OpSub] = &&TARGET_OpSub, [OpMul] = &&TARGET_OpMul,
+        [OpLower] = &&TARGET_OpLower, [OpGreather] = &&TARGET_OpGreather,
+        [OpLowerEq] = &&TARGET_OpLowerEq, [OpGreatherEq] = &&TARGET_OpGreatherEq,
+        [OpEqual] = &&TARGET_OpEqual, [OpNotEqual] = &&TARGET_OpNotEqual,
+        [OpNot] = &&TARGET_OpNot, [OpAnd] = &&TARGET_OpAnd, [OpOr] = &&TARGET_OpOr,
+        [OpDup] = &&TARGET_OpDup, [OpSwap] = &&TARGET_OpSwap, [OpDrop] = &&TARGET_OpDrop,
+        [OpNop] = &&TARGET_OpNop,
+        [OpApply] = &&TARGET_OpApply, [OpIf] = &&TARGET_OpIf, [OpDip] = &&TARGET_OpDip,
+        [OpSumImm] = &&TARGET_OpSumImm, [OpSubImm] = &&TARGET_OpSubImm, [OpMulImm] = &&TARGET_OpMulImm,
+        [OpLowerImm] = &&TARGET_OpLowerImm, [OpGreatherImm] = &&TARGET_OpGreatherImm,
+        [OpLowerEqImm] = &&TARGET_OpLowerEqImm, [OpGreatherEqImm] = &&TARGET_OpGreatherEqImm,
+        [OpEqualImm] = &&TARGET_OpEqualImm, [OpNotEqualImm] = &&TARGET_OpNotEqualImm,
+        [OpSquare] = &&TARGET_OpSquare, [OpSwapSub] = &&TARGET_OpSwapSub,
+        [OpSizeGreatherImm] = &&TARGET_OpSizeGreatherImm, [OpDupNMulImm] = &&TARGET_OpDupNMulImm,
+        [OpSumInt] = &&TARGET_OpSumInt, [OpSubInt] = &&TARGET_OpSubInt, [OpMulInt] = &&TARGET_OpMulInt,
+        [OpLowerInt] = &&TARGET_OpLowerInt, [OpGreatherInt] = &&TARGET_OpGreatherInt,
+        [OpLowerEqInt] = &&TARGET_OpLowerEqInt, [OpGreatherEqInt] = &&TARGET_OpGreatherEqInt,
+        [OpEqualInt] = &&TARGET_OpEqualInt, [OpNotEqualInt] = &&TARGET_OpNotEqualInt,
+        [OpNotBool] = &&TARGET_OpNotBool, [OpAndBool] = &&TARGET_OpAndBool, [OpOrBool] = &&TARGET_OpOrBool,
+        [OpIfBool] = &&TARGET_OpIfBool,
+        [OpLowerImmInt] = &&TARGET_OpLowerImmInt, [OpGreatherImmInt] = &&TARGET_OpGreatherImmInt,
+        [OpLowerEqImmInt] = &&TARGET_OpLowerEqImmInt, [OpGreatherEqImmInt] = &&TARGET_OpGreatherEqImmInt,
+        [OpEqualImmInt] = &&TARGET_OpEqualImmInt, [OpNotEqualImmInt] = &&TARGET_OpNotEqualImmInt,
+        [OpSumFloat] = &&TARGET_OpSumFloat, [OpSubFloat] = &&TARGET_OpSubFloat, [OpMulFloat] = &&TARGET_OpMulFloat,
+        [OpLowerFloat] = &&TARGET_OpLowerFloat, [OpGreatherFloat] = &&TARGET_OpGreatherFloat, [OpLowerEqFloat] = &&TARGET_OpLowerEqFloat,
+        [OpGreatherEqFloat] = &&TARGET_OpGreatherEqFloat, [OpEqualFloat] = &&TARGET_OpEqualFloat, [OpNotEqualFloat] = &&TARGET_OpNotEqualFloat,
+        [OpSumImmFloat] = &&TARGET_OpSumImmFloat, [OpSubImmFloat] = &&TARGET_OpSubImmFloat, [OpMulImmFloat] = &&TARGET_OpMulImmFloat,
+        [OpLowerImmFloat] = &&TARGET_OpLowerImmFloat, [OpGreatherImmFloat] = &&TARGET_OpGreatherImmFloat, [OpLowerEqImmFloat] = &&TARGET_OpLowerEqImmFloat,
+        [OpGreatherEqImmFloat] = &&TARGET_OpGreatherEqImmFloat, [OpEqualImmFloat] = &&TARGET_OpEqualImmFloat, [OpNotEqualImmFloat] = &&TARGET_OpNotEqualImmFloat,
+        [End] = &&TARGET_End
+    };
+#endif
+    struct Stack *const stack = state->stack;
+    struct StackElem *bottom, *sp, *limit;
+    struct Instr *instr;
+    struct StackElem elem;
+    struct ProgramState sstat;
+    // words and quotations are run in this loop using the frames of jbuff, frames under base
+    // belong to the execute_code calls that are running this one
+    const size_t base = jbuff->fr_size;
+    struct Frame frame;
+    // code may run on the level of the caller, its source is given back when it returns
+    const struct BtSource outer = jbuff->bt_src[jbuff->bt_size - 1];
+    enter_Backtrace(jbuff, code);
+    instr = enter_Code(state, code, jbuff);
+    RELOAD();
+#ifdef THREADED_DISPATCH
+    DISPATCH();
+#else
+    while(1) switch(instr_OpCode(instr)){
+#endif
+        TARGET(PushInt):
+            elem.type = Integer;
+            elem.val.ival = instr->token.info.integer;
+            PUSH(elem);
+            NEXT();
+
+        TARGET(PushFloat):
+            elem.type = Floating;
+            elem.val.fval = instr->token.info.decimal;
+            PUSH(elem);
+            NEXT();
+
+        TARGET(PushBool):
+            elem.type = Boolean;
+            elem.val.ival = instr->token.info.integer;
+            PUSH(elem);
+            NEXT();
+
+        TARGET(PushString):
+            SET_NOT_EXEC();
+            elem.type = String;
+            if(!set_Text(&elem, instr->token.instr, instr->token.info.stringlen)){
+                SPILL();
+                RAISE(jbuff, ProgramPanic);
+            }
+            PUSH(elem);
+            NEXT();
+
+        TARGET(PushQuote):
+            SET_NOT_EXEC();
+            elem.type = Instruction;
+            if(!set_Text(&elem, instr->token.instr, instr->token.info.stringlen)){
+                SPILL();
+                RAISE(jbuff, ProgramPanic);
+            }
+            elem.code = retain_Code(instr->quote);
+            PUSH(elem);
+            NEXT();
+
+        TARGET(PushStack):
+            SET_NOT_EXEC();
+            SPILL();
+            elem = new_Stack(jbuff);
+            sstat.stack = elem.val.stack;
+            sstat.env = state->env;
+            add_backtrace(jbuff);
+            execute_code(&sstat, instr->quote, jbuff);
+            remove_backtrace(jbuff);
+            push_Stack(stack, elem, jbuff);
+            RELOAD();
+            NEXT();
+
+        TARGET(CallOp):
+            SET_NOT_EXEC();
+            SPILL();
+            instr->arg.op(state, jbuff);
+            RELOAD();
+            NEXT();
+
+        TARGET(CallBrOp):
+            SET_NOT_EXEC();
+            SPILL();
+            instr->arg.brop(state, instr->token.instr + instr->token.info.special.val + 1, instr->token.info.special.instrlen, jbuff);
+            RELOAD();
+            NEXT();
+
+        TARGET(CallBrCode):
+            SPILL();
+            execute_code(state, instr->quote, jbuff);
+            SET_NOT_EXEC();
+            instr->arg.brop(state, instr->token.instr + instr->token.info.special.val + 1, 0, jbuff);
+            RELOAD();
+            NEXT();
+
+        TARGET(CallBrNumOp):
+            SET_NOT_EXEC();
+            SPILL();
+            if(instr->arg.brnum.brop == NULL || instr->arg.brnum.num < stack->next)
+                instr->arg.brnum.numop(state, instr->arg.brnum.num, jbuff);
+            else
+                instr->arg.brnum.brop(state, instr->token.instr + instr->token.info.special.val + 1, instr->token.info.special.instrlen, jbuff);
+            RELOAD();
+            NEXT();
+
+        TARGET(CallCodeOp):
+            SET_NOT_EXEC();
+            SPILL();
+            instr->arg.brcode.codeop(state, instr->quote, jbuff);
+            RELOAD();
+            NEXT();
+
+        TARGET(CallNumOp):
+            SET_NOT_EXEC();
+            SPILL();
+            instr->arg.numop(state, instr->token.info.special.val, jbuff);
+            RELOAD();
+            NEXT();
+
+        TARGET(CallWord):
+            SET_NOT_EXEC();
+            SPILL();
+            frame.code = retain_Code(cached_Word(&instr->arg.word, state->env));
+            if(frame.code == NULL)
+                RAISE(jbuff, InvalidInstruction);
+            frame.dip = 0;
+            goto call;
+
+        TARGET(RaiseError):
+            SET_NOT_EXEC();
+            SPILL();
+            RAISE(jbuff, instr->token.info.integer);
+
+        TARGET(OpSum):
+            INT_BINARY(+, op_sum, OpSumFloat);
+
+        TARGET(OpSub):
+            INT_BINARY(-, op_sub, OpSubFloat);
+
+        TARGET(OpMul):
+            INT_BINARY(*, op_mul, OpMulFloat);
+
+        TARGET(OpLower):
+            INT_COMPARE(<, op_lower, OpLowerFloat);
+
+        TARGET(OpGreather):
+            INT_COMPARE(>, op_greather, OpGreatherFloat);
+
+        TARGET(OpLowerEq):
+            INT_COMPARE(<=, op_lowereq, OpLowerEqFloat);
+
+        TARGET(OpGreatherEq):
+            INT_COMPARE(>=, op_greathereq, OpGreatherEqFloat);
+
+        TARGET(OpEqual):
+            INT_COMPARE(==, op_equal, OpEqualFloat);
+
+        TARGET(OpNotEqual):
+            INT_COMPARE(!=, op_notequal, OpNotEqualFloat);
+
+        TARGET(OpNot):
+            if(HAS_ELEMS(1) && TOS(1).type == Boolean){
+                TOS(1).val.ival = ! TOS(1).val.ival;
+            }else{
+                SET_NOT_EXEC();
+                SPILL();
+                op_not(state, jbuff);
+                RELOAD();
+            }
+            NEXT();
+
+        TARGET(OpAnd):
+            BOOL_BINARY(&, op_and);
+
+        TARGET(OpOr):
+            BOOL_BINARY(|, op_or);
+
+        TARGET(OpDup):
+            if(HAS_ELEMS(1) && IS_SCALAR(TOS(1).type)){
+                PUSH(TOS(1));
+            }else{
+                SET_NOT_EXEC();
+                SPILL();
+                op_dup(state, jbuff);
+                RELOAD();
+            }
+            NEXT();
+
+        TARGET(OpSwap):
+            if(HAS_ELEMS(2)){
+                elem = TOS(1);
+                TOS(1) = TOS(2);
+                TOS(2) = elem;
+            }else{
+                SET_NOT_EXEC();
+                SPILL();
+                op_swap(state, jbuff);
+                RELOAD();
+            }
+            NEXT();
+
+        TARGET(OpDrop):
+            if(HAS_ELEMS(1) && IS_SCALAR(TOS(1).type)){
+                sp -= 1;
+            }else{
+                SET_NOT_EXEC();
+                SPILL();
+                op_drop(state, jbuff);
+                RELOAD();
+            }
+            NEXT();
+
+        TARGET(OpNop):
+            NEXT();
+
+        TARGET(OpApply):
+            SET_NOT_EXEC();
+            SPILL();
+            if(!HAS_ELEMS(1))
+                RAISE(jbuff, StackUnderflow);
+            if(TOS(1).type != Instruction)
+                RAISE(jbuff, InvalidOperands);
+            sp -= 1;
+            SPILL();
+            frame.code = take_Quotation(sp, jbuff);
+            frame.dip = 0;
+            goto call;
+
+        TARGET(OpIf):
+            SET_NOT_EXEC();
+            SPILL();
+            if(!HAS_ELEMS(3))
+                RAISE(jbuff, StackUnderflow);
+            if(TOS(1).type != Instruction)
+                RAISE(jbuff, InvalidOperands);
+            if(TOS(2).type != Instruction || TOS(3).type != Boolean)
+                RAISE(jbuff, InvalidOperands);
+            goto branch;
+
+        TARGET(OpIfBool):
+            SET_NOT_EXEC();
+            SPILL();
+        branch:
+            if(TOS(3).val.ival){
+                frame.code = take_Quotation(&TOS(2), jbuff);
+                release_Text(&TOS(1));
+                release_Code(TOS(1).code);
+            }else{
+                frame.code = take_Quotation(&TOS(1), jbuff);
+                release_Text(&TOS(2));
+                release_Code(TOS(2).code);
+            }
+            sp -= 3;
+            frame.dip = 0;
+            goto call;
+
+        TARGET(OpDip):
+            SET_NOT_EXEC();
+            SPILL();
+            if(!HAS_ELEMS(2))
+                RAISE(jbuff, StackUnderflow);
+            if(TOS(1).type != Instruction)
+                RAISE(jbuff, InvalidOperands);
+            frame.code = take_Quotation(&TOS(1), jbuff);
+            frame.dip = 1;
+            frame.saved = TOS(2);
+            sp -= 2;
+            goto call;
+
+        TARGET(OpSumImm):
+            INT_IMMEDIATE(+, op_sum, OpSumImmFloat);
+
+        TARGET(OpSubImm):
+            INT_IMMEDIATE(-, op_sub, OpSubImmFloat);
+
+        TARGET(OpMulImm):
+            INT_IMMEDIATE(*, op_mul, OpMulImmFloat);
+
+        TARGET(OpLowerImm):
+            INT_COMPARE_IMMEDIATE(<, op_lower, OpLowerImmFloat);
+
+        TARGET(OpGreatherImm):
+            INT_COMPARE_IMMEDIATE(>, op_greather, OpGreatherImmFloat);
+
+        TARGET(OpLowerEqImm):
+            INT_COMPARE_IMMEDIATE(<=, op_lowereq, OpLowerEqImmFloat);
+
+        TARGET(OpGreatherEqImm):
+            INT_COMPARE_IMMEDIATE(>=, op_greathereq, OpGreatherEqImmFloat);
+
+        TARGET(OpEqualImm):
+            INT_COMPARE_IMMEDIATE(==, op_equal, OpEqualImmFloat);
+
+        TARGET(OpNotEqualImm):
+            INT_COMPARE_IMMEDIATE(!=, op_notequal, OpNotEqualImmFloat);
+
+        TARGET(OpSquare):
+            if(HAS_ELEMS(1) && TOS(1).type == Integer){
+                TOS(1).val.ival = TOS(1).val.ival * TOS(1).val.ival;
+            }else{
+                SET_NOT_EXEC();
+                SPILL();
+                op_dup(state, jbuff);
+                SET_NOT_EXEC_LAST();
+                op_mul(state, jbuff);
+                RELOAD();
+            }
+            NEXT();
+
+        TARGET(OpSwapSub):
+            if(HAS_ELEMS(2) && TOS(1).type == Integer && TOS(2).type == Integer){
+                TOS(2).val.ival = TOS(1).val.ival - TOS(2).val.ival;
+                sp -= 1;
+            }else{
+                SET_NOT_EXEC();
+                SPILL();
+                op_swap(state, jbuff);
+                SET_NOT_EXEC_LAST();
+                op_sub(state, jbuff);
+                RELOAD();
+            }
+            NEXT();
+
+        TARGET(OpSizeGreatherImm):
+            SET_NOT_EXEC();
+            elem.type = Boolean;
+            elem.val.ival = (int64_t)DEPTH() > instr->arg.fused.imm;
+            PUSH(elem);
+            NEXT();
+
+        TARGET(OpDupNMulImm):
+            if(instr->arg.fused.num < DEPTH() && TOS(instr->arg.fused.num + 1).type == Integer){
+                SET_NOT_EXEC();
+                elem.type = Integer;
+                elem.val.ival = TOS(instr->arg.fused.num + 1).val.ival * instr->arg.fused.imm;
+                PUSH(elem);
+            }else{
+                SET_NOT_EXEC();
+                SPILL();
+                numop_dup(state, instr->arg.fused.num, jbuff);
+                SET_NOT_EXEC_LAST();
+                PUSH_IMM();
+                op_mul(state, jbuff);
+                RELOAD();
+            }
+            NEXT();
+
+        TARGET(OpSumInt):
+            INT_BINARY_UNCHECKED(+);
+
+        TARGET(OpSubInt):
+            INT_BINARY_UNCHECKED(-);
+
+        TARGET(OpMulInt):
+            INT_BINARY_UNCHECKED(*);
+
+        TARGET(OpLowerInt):
+            INT_COMPARE_UNCHECKED(<);
+
+        TARGET(OpGreatherInt):
+            INT_COMPARE_UNCHECKED(>);
+
+        TARGET(OpLowerEqInt):
+            INT_COMPARE_UNCHECKED(<=);
+
+        TARGET(OpGreatherEqInt):
+            INT_COMPARE_UNCHECKED(>=);
+
+        TARGET(OpEqualInt):
+            INT_COMPARE_UNCHECKED(==);
+
+        TARGET(OpNotEqualInt):
+            INT_COMPARE_UNCHECKED(!=);
+
+        TARGET(OpNotBool):
+            TOS(1).val.ival = ! TOS(1).val.ival;
+            NEXT();
+
+        TARGET(OpAndBool):
+            INT_BINARY_UNCHECKED(&);
+
+        TARGET(OpOrBool):
+            INT_BINARY_UNCHECKED(|);
+
+        TARGET(OpLowerImmInt):
+            INT_COMPARE_IMMEDIATE_UNCHECKED(<);
+
+        TARGET(OpGreatherImmInt):
+            INT_COMPARE_IMMEDIATE_UNCHECKED(>);
+
+        TARGET(OpLowerEqImmInt):
+            INT_COMPARE_IMMEDIATE_UNCHECKED(<=);
+
+        TARGET(OpGreatherEqImmInt):
+            INT_COMPARE_IMMEDIATE_UNCHECKED(>=);
+
+        TARGET(OpEqualImmInt):
+            INT_COMPARE_IMMEDIATE_UNCHECKED(==);
+
+        TARGET(OpNotEqualImmInt):
+            INT_COMPARE_IMMEDIATE_UNCHECKED(!=);
+
+        TARGET(OpSumFloat):
+            FLOAT_BINARY(+, OpSum);
+
+        TARGET(OpSubFloat):
+            FLOAT_BINARY(-, OpSub);
+
+        TARGET(OpMulFloat):
+            FLOAT_BINARY(*, OpMul);
+
+        TARGET(OpLowerFloat):
+            FLOAT_COMPARE(<, OpLower);
+
+        TARGET(OpGreatherFloat):
+            FLOAT_COMPARE(>, OpGreather);
+
+        TARGET(OpLowerEqFloat):
+            FLOAT_COMPARE(<=, OpLowerEq);
+
+        TARGET(OpGreatherEqFloat):
+            FLOAT_COMPARE(>=, OpGreatherEq);
+
+        TARGET(OpEqualFloat):
+            FLOAT_COMPARE(==, OpEqual);
+
+        TARGET(OpNotEqualFloat):
+            FLOAT_COMPARE(!=, OpNotEqual);
+
+        TARGET(OpSumImmFloat):
+            FLOAT_IMMEDIATE(+, OpSumImm);
+
+        TARGET(OpSubImmFloat):
+            FLOAT_IMMEDIATE(-, OpSubImm);
+
+        TARGET(OpMulImmFloat):
+            FLOAT_IMMEDIATE(*, OpMulImm);
+
+        TARGET(OpLowerImmFloat):
+            FLOAT_COMPARE_IMMEDIATE(<, OpLowerImm);
+
+        TARGET(OpGreatherImmFloat):
+            FLOAT_COMPARE_IMMEDIATE(>, OpGreatherImm);
+
+        TARGET(OpLowerEqImmFloat):
+            FLOAT_COMPARE_IMMEDIATE(<=, OpLowerEqImm);
+
+        TARGET(OpGreatherEqImmFloat):
+            FLOAT_COMPARE_IMMEDIATE(>=, OpGreatherEqImm);
+
+        TARGET(OpEqualImmFloat):
+            FLOAT_COMPARE_IMMEDIATE(==, OpEqualImm);
+
+        TARGET(OpNotEqualImmFloat):
+            FLOAT_COMPARE_IMMEDIATE(!=, OpNotEqualImm);
+
+        TARGET(End):
+            if(jbuff->fr_size == base){
+                SPILL();
+                jbuff->bt_src[jbuff->bt_size - 1] = outer;
+                return;
+            }
+            jbuff->fr_size -= 1;
+            frame = jbuff->frames[jbuff->fr_size];
+            instr = frame.ret;
+            release_Code(frame.code);
+            remove_backtrace(jbuff);
+            if(frame.dip){
+                PUSH(frame.saved);
+            }
+            DISPATCH();
+
+        // frame holds the code to run: a call in tail position replaces the running frame
+        // instead of pushing a new one, unless it still has to restore an element after a dip
+        call:
+            SPILL();
+            if(instr_OpCode(instr + 1) == End && jbuff->fr_size > base && !jbuff->frames[jbuff->fr_size - 1].dip){
+                struct Frame *top = &jbuff->frames[jbuff->fr_size - 1];
+                release_Code(top->code);
+                frame.ret = top->ret;
+                *top = frame;
+            }else{
+                frame.ret = instr + 1;
+                push_Frame(jbuff, frame);
+                add_backtrace(jbuff);
+            }
+            enter_Backtrace(jbuff, frame.code);
+            instr = enter_Code(state, frame.code, jbuff);
+            RELOAD();
+            DISPATCH();
+#ifndef THREADED_DISPATCH
+        default:
+            UNREACHABLE;
+    }
+#endif
+}
+
+#ifdef THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,266 @@
+#ifndef SSCRIPT_COMPILER_H
+#define SSCRIPT_COMPILER_H
+#include "interpreter.h"
+#include <stdatomic.h>
+
+#define CODE_CAPACITY 16
+
+enum OpCode{
+	PushInt,
+	PushFloat,
+	PushBool,
+	PushString,
+	PushQuote,
+	PushStack,
+	CallOp,
+	CallBrOp,
+	CallBrCode,
+	CallBrNumOp,
+	CallCodeOp,
+	CallNumOp,
+	CallWord,
+	RaiseError,
+	OpSum,
+	OpSub,
+	OpMul,
+	OpLower,
+	OpGreather,
+	OpLowerEq,
+	OpGreatherEq,
+	OpEqual,
+	OpNotEqual,
+	OpNot,
+	OpAnd,
+	OpOr,
+	OpDup,
+	OpSwap,
+	OpDrop,
+	OpNop,
+	OpApply,
+	OpIf,
+	OpDip,
+	OpSumImm,
+	OpSubImm,
+	OpMulImm,
+	OpLowerImm,
+	OpGreatherImm,
+	OpLowerEqImm,
+	OpGreatherEqImm,
+	OpEqualImm,
+	OpNotEqualImm,
+	OpSquare,
+	OpSwapSub,
+	OpSizeGreatherImm,
+	OpDupNMulImm,
+	// unchecked versions of OpSum...OpOr, OpIf and OpLowerImm...OpNotEqualImm, in the same order:
+	// infer_Code proved the depth of the stack and the types of their operands
+	OpSumInt,
+	OpSubInt,
+	OpMulInt,
+	OpLowerInt,
+	OpGreatherInt,
+	OpLowerEqInt,
+	OpGreatherEqInt,
+	OpEqualInt,
+	OpNotEqualInt,
+	OpNotBool,
+	OpAndBool,
+	OpOrBool,
+	OpIfBool,
+	OpLowerImmInt,
+	OpGreatherImmInt,
+	OpLowerEqImmInt,
+	OpGreatherEqImmInt,
+	OpEqualImmInt,
+	OpNotEqualImmInt,
+	// quickened versions of OpSum...OpNotEqual and OpSumImm...OpNotEqualImm, in the same order:
+	// the generic instruction rewrites itself to them once it finds floating operands
+	OpSumFloat,
+	OpSubFloat,
+	OpMulFloat,
+	OpLowerFloat,
+	OpGreatherFloat,
+	OpLowerEqFloat,
+	OpGreatherEqFloat,
+	OpEqualFloat,
+	OpNotEqualFloat,
+	OpSumImmFloat,
+	OpSubImmFloat,
+	OpMulImmFloat,
+	OpLowerImmFloat,
+	OpGreatherImmFloat,
+	OpLowerEqImmFloat,
+	OpGreatherEqImmFloat,
+	OpEqualImmFloat,
+	OpNotEqualImmFloat,
+	End
+};
+
+// the generic opcode of an unchecked or quickened one, the instruction arguments are the same
+static inline enum OpCode generic_OpCode(enum OpCode opcode){
+	if(opcode < OpSumInt || opcode == End)
+		return opcode;
+	if(opcode <= OpOrBool)
+		return OpSum + (opcode - OpSumInt);
+	if(opcode == OpIfBool)
+		return OpIf;
+	if(opcode <= OpNotEqualImmInt)
+		return OpLowerImm + (opcode - OpLowerImmInt);
+	if(opcode <= OpNotEqualFloat)
+		return OpSum + (opcode - OpSumFloat);
+	return OpSumImm + (opcode - OpSumImmFloat);
+}
+
+// opcodes that the VM runs on a new frame, the native code of jit.c and aot.c stops before them
+static inline int is_Call(enum OpCode opcode){
+	opcode = generic_OpCode(opcode);
+	return opcode == CallWord || opcode == OpApply || opcode == OpIf || opcode == OpDip;
+}
+
+// operands of a superinstruction: the token of the instruction is the one of the first fused
+// instruction, lasttoken points to the last one
+struct FusedArg{
+	int64_t imm;
+	size_t num;
+	char *lasttoken;
+};
+
+// bracket instruction with a constant argument: numop runs it while num is a valid stack index,
+// otherwise brop is called on the original text to raise the same error
+struct BrNumArg{
+	br_operations brop;
+	num_operations numop;
+	size_t num;
+};
+
+// bracket instruction with its argument compiled in quote: codeop runs it, brop is kept to save the
+// instruction in images
+struct BrCodeArg{
+	br_operations brop;
+	code_operations codeop;
+};
+
+// Definition of the symbol called by a CallWord, valid while generation is equal to definition_generation.
+// The threads of pinject share it: a refill is claimed by setting generation to WORD_CACHE_BUSY, so only
+// one thread at a time stores code before it publishes the new generation with release.
+#define WORD_CACHE_BUSY SIZE_MAX
+struct WordCache{
+	_Atomic(struct Code *) code;
+	atomic_size_t generation;
+	uint32_t symbol;
+};
+
+union InstrArg{
+	operations op;
+	br_operations brop;
+	num_operations numop;
+	struct FusedArg fused;
+	struct BrNumArg brnum;
+	struct BrCodeArg brcode;
+	struct WordCache word;
+};
+
+struct Instr{
+	// rewritten by quickening while other threads can be running the instruction, see instr_OpCode
+	_Atomic(enum OpCode) opcode;
+	union InstrArg arg;
+	struct Token token;
+	struct Code *quote;
+};
+
+// Once its code is run the opcode of an instruction only changes between its generic and its quickened
+// versions, which are all correct for it: it's read and rewritten with relaxed atomics.
+static inline enum OpCode instr_OpCode(const struct Instr *instr){
+	return atomic_load_explicit(&instr->opcode, memory_order_relaxed);
+}
+
+static inline void quicken_Instr(struct Instr *instr, enum OpCode opcode){
+	atomic_store_explicit(&instr->opcode, opcode, memory_order_relaxed);
+}
+
+struct Code{
+	struct Instr *instrs;
+	size_t size;
+	size_t capacity;
+	// src is a slice of text, which is shared with the quotations and the arguments compiled from it
+	char *src;
+	size_t srclen;
+	struct Text *text;
+	atomic_size_t refcount;
+	// Machine code running the first jitlen instructions, see jit.c. It's translated by the thread that
+	// brings hotness to JIT_THRESHOLD and published with release after jitlen and jitsize.
+	_Atomic(operations) jit;
+	size_t jitlen;
+	size_t jitsize;
+	atomic_uint hotness;
+};
+
+struct Code *new_Code(char *comands, size_t clen);
+struct Code *compile_script(char *comands, size_t clen, struct ExceptionHandler *jbuff);
+void print_fusions();
+code_operations bracket_CodeOp(br_operations brop);
+
+// Piece of a code generated by --emit-c: fn runs the instructions before the call opcode, NULL when there
+// are none, and the token of the call is the slice of len characters at off in the source. The last one is End.
+struct NativePart{
+	operations fn;
+	enum OpCode opcode;
+	size_t off;
+	size_t len;
+};
+
+struct Code *native_Code(char *src, size_t srclen, const struct NativePart *parts, size_t num);
+
+static inline struct Code *quotation_Code(struct StackElem *quot, struct ExceptionHandler *jbuff){
+	if(quot->code == NULL)
+		quot->code = compile_script(text_Elem(quot), text_Len(quot), jbuff);
+	return quot->code;
+}
+
+// code of the quotation popped from the stack in quot, whose text is released: the code keeps its source
+static inline struct Code *take_Quotation(struct StackElem *quot, struct ExceptionHandler *jbuff){
+	struct Code *code = quotation_Code(quot, jbuff);
+	release_Text(quot);
+	return code;
+}
+
+// Definition cached by cache, it's looked up again when a word is defined or deleted. The code is never
+// older than the generation it's cached with: a thread that doesn't get the refill keeps what it found.
+static inline struct Code *cached_Word(struct WordCache *cache, struct Environment *env){
+	size_t generation = atomic_load_explicit(&definition_generation, memory_order_acquire);
+	size_t cached = atomic_load_explicit(&cache->generation, memory_order_acquire);
+	if(cached == generation)
+		return atomic_load_explicit(&cache->code, memory_order_acquire);
+	struct Code *code = find_word(env, cache->symbol);
+	if(cached != WORD_CACHE_BUSY && atomic_compare_exchange_strong_explicit(&cache->generation, &cached, WORD_CACHE_BUSY,
+			memory_order_acquire, memory_order_relaxed)){
+		atomic_store_explicit(&cache->code, code, memory_order_release);
+		atomic_store_explicit(&cache->generation, generation, memory_order_release);
+	}
+	return code;
+}
+
+// the current backtrace level runs code
+static inline void enter_Backtrace(struct ExceptionHandler *jbuff, const struct Code *code){
+	jbuff->not_exec[jbuff->bt_size - 1] = code->src;
+	jbuff->bt_src[jbuff->bt_size - 1].start = code->src;
+	jbuff->bt_src[jbuff->bt_size - 1].end = code->src + code->srclen;
+}
+
+static inline void push_Frame(struct ExceptionHandler *jbuff, struct Frame frame){
+	if(jbuff->fr_size == jbuff->fr_capacity){
+		struct Frame *newmem = realloc(jbuff->frames, sizeof(struct Frame) * jbuff->fr_capacity * 2);
+		if(newmem == NULL){
+			release_Code(frame.code);
+			RAISE(jbuff, ProgramPanic);
+		}
+		jbuff->frames = newmem;
+		jbuff->fr_capacity *= 2;
+	}
+	jbuff->frames[jbuff->fr_size] = frame;
+	jbuff->fr_size += 1;
+}
+
+void execute_code(struct ProgramState *state, struct Code *code, struct ExceptionHandler *jbuff);
+
+#endif
@@ -4,6 +4,14 @@
 
 #include "environment.h"
 #include "math.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "memdebug.h"
+
+#define SYMBOL_HASHKEY0 0x734bc7ed439782a3ULL
+#define SYMBOL_HASHKEY1 0x542f7629b02ac4deULL
+#define SYMBOLS_CAPACITY 64
 
 #define SIPROUND \
         v0 += v1; \
@@ -74,4 +82,107 @@ uint64_t SipHash_2_4(const uint64_t keytop, const uint64_t keybottom, const char
     SIPROUND
     SIPROUND
     return v0 ^ v1 ^ v2 ^ v3;
-}
\ No newline at end of file
+}
+
+struct SymbolTable symbols;
+
+// the threads of numop_pinject compile quotations too: the table is read and changed holding symbols_lock
+static atomic_int symbols_lock;
+
+static inline void lock_Symbols(){
+    while (atomic_exchange_explicit(&symbols_lock, 1, memory_order_acquire))
+        ;
+}
+
+static inline void unlock_Symbols(){
+    atomic_store_explicit(&symbols_lock, 0, memory_order_release);
+}
+
+// open addressing: a slot holds symbol + 1, 0 if it's empty
+static inline size_t symbol_Slot(const char *name, size_t namelen){
+    size_t mask = symbols.slots_capacity - 1;
+    size_t index = (size_t)SipHash_2_4(SYMBOL_HASHKEY0, SYMBOL_HASHKEY1, name, namelen) & mask;
+    while (symbols.slots[index] != 0) {
+        const char *other = symbols.names[symbols.slots[index] - 1];
+        if (strncmp(other, name, namelen) == 0 && other[namelen] == '\0')
+            return index;
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+// the table is left as it is when the memory can't be allocated
+static inline int grow_Symbols(){
+    size_t capacity = symbols.capacity == 0 ? SYMBOLS_CAPACITY : symbols.capacity * 2;
+    uint32_t *slots = calloc(capacity * 2, sizeof(uint32_t));
+    if (slots == NULL)
+        return 0;
+    char **names = realloc(symbols.names, sizeof(char *) * capacity);
+    if (names == NULL){
+        free(slots);
+        return 0;
+    }
+    symbols.names = names;
+    symbols.capacity = capacity;
+    if (symbols.slots != NULL)
+        free(symbols.slots);
+    symbols.slots = slots;
+    symbols.slots_capacity = capacity * 2;
+    for (size_t i = 0; i < symbols.size; i++) {
+        symbols.slots[symbol_Slot(symbols.names[i], strlen(symbols.names[i]))] = (uint32_t)(i + 1);
+    }
+    return 1;
+}
+
+static inline uint32_t lookup_Symbol(const char *name, size_t namelen){
+    if (symbols.size == 0)
+        return SYMBOL_ERROR;
+    uint32_t slot = symbols.slots[symbol_Slot(name, namelen)];
+    return slot == 0 ? SYMBOL_ERROR : slot - 1;
+}
+
+uint32_t find_Symbol(const char *name, size_t namelen){
+    lock_Symbols();
+    uint32_t symbol = lookup_Symbol(name, namelen);
+    unlock_Symbols();
+    return symbol;
+}
+
+static inline uint32_t add_Symbol(const char *name, size_t namelen){
+    if (symbols.size == symbols.capacity && (symbols.size + 1 >= SYMBOL_ERROR || !grow_Symbols()))
+        return SYMBOL_ERROR;
+    char *copy = malloc(namelen + 1);
+    if (copy == NULL)
+        return SYMBOL_ERROR;
+    memcpy(copy, name, namelen);
+    copy[namelen] = '\0';
+    uint32_t symbol = (uint32_t)symbols.size;
+    symbols.slots[symbol_Slot(name, namelen)] = symbol + 1;
+    symbols.names[symbol] = copy;
+    symbols.size += 1;
+    return symbol;
+}
+
+uint32_t intern_Symbol(const char *name, size_t namelen){
+    lock_Symbols();
+    uint32_t symbol = lookup_Symbol(name, namelen);
+    if (symbol == SYMBOL_ERROR)
+        symbol = add_Symbol(name, namelen);
+    unlock_Symbols();
+    return symbol;
+}
+
+void free_Symbols(){
+    for (size_t i = 0; i < symbols.size; i++) {
+        free(symbols.names[i]);
+    }
+    if (symbols.names != NULL)
+        free(symbols.names);
+    if (symbols.slots != NULL)
+        free(symbols.slots);
+    symbols.names = NULL;
+    symbols.slots = NULL;
+    symbols.size = 0;
+    symbols.capacity = 0;
+    symbols.slots_capacity = 0;
+}
@@ -9,14 +9,29 @@
 #include <stddef.h>
 #include "math.h"
 
-struct EnvElem{
-    char *key;
-    char *value;
-    struct EnvElem *next;
+struct Code;
+
+// every identifier is interned once in the symbol table and then referred by its symbol,
+// a dense index in symbols.names
+#define SYMBOL_ERROR UINT32_MAX
+
+struct SymbolTable{
+    char **names;
+    size_t size;
+    size_t capacity;
+    uint32_t *slots;
+    size_t slots_capacity;
 };
 
+extern struct SymbolTable symbols;
+
+uint32_t intern_Symbol(const char *name, size_t namelen);
+uint32_t find_Symbol(const char *name, size_t namelen);
+void free_Symbols();
+
+// definitions indexed by symbol, NULL if the symbol is not defined
 struct Environment{
-    struct EnvElem **content;
+    struct Code **content;
     size_t capacity;
 };
 
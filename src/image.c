@@ -0,0 +1,577 @@
+#define _DEFAULT_SOURCE
+#include "image.h"
+#include "builtins_hash.h"
+#if defined(__unix__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define IMAGE_VERSION 2
+
+struct ImageHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t opcodes;
+    uint32_t ops;
+    uint32_t brops;
+    uint32_t numops;
+    uint32_t elemsize;
+    uint64_t codes;
+    uint64_t srchash;
+    uint64_t srclen;
+};
+
+static const char IMAGE_MAGIC[8] = "SSKIMG\r\n";
+static const char CACHE_MAGIC[8] = "SSKSC\r\n";
+
+// pointers are saved as offsets in the source of the code, builtins as indexes in their table
+struct ImageInstr{
+    uint32_t opcode;
+    uint32_t tokentype;
+    uint64_t tokenoff;
+    union TokenInfo info;
+    uint64_t quote;
+    uint64_t arg[3];
+};
+
+#define NUMOP_TIMES NUMOP_HASHED_SIZE
+
+struct ImageWriter{
+    FILE *out;
+    struct Code **codes;
+    size_t size;
+    size_t capacity;
+    struct ExceptionHandler *jbuff;
+};
+
+static void write_Bytes(struct ImageWriter *w, const void *data, size_t len){
+    if(len != 0 && fwrite(data, 1, len, w->out) != len)
+        RAISE(w->jbuff, IOError);
+}
+
+static void write_U64(struct ImageWriter *w, uint64_t val){
+    write_Bytes(w, &val, sizeof(val));
+}
+
+static size_t code_Number(struct ImageWriter *w, struct Code *code){
+    for(size_t i = 0; i < w->size; i++){
+        if(w->codes[i] == code)
+            return i + 1;
+    }
+    return 0;
+}
+
+// numbers the code after the ones it contains, so that every quotation is loaded before it's referred
+static void collect_Code(struct ImageWriter *w, struct Code *code){
+    if(code == NULL || code_Number(w, code) != 0)
+        return;
+    for(size_t i = 0; i < code->size; i++)
+        collect_Code(w, code->instrs[i].quote);
+    if(w->size == w->capacity){
+        struct Code **newmem = realloc(w->codes, sizeof(struct Code *) * w->capacity * 2);
+        if(newmem == NULL)
+            RAISE(w->jbuff, ProgramPanic);
+        w->codes = newmem;
+        w->capacity *= 2;
+    }
+    w->codes[w->size] = code;
+    w->size += 1;
+}
+
+static void collect_Stack(struct ImageWriter *w, struct Stack *stack){
+    for(size_t i = 0; i < stack->next; i++){
+        if(stack->content[i].type == Instruction)
+            collect_Code(w, stack->content[i].code);
+        else if(stack->content[i].type == InnerStack)
+            collect_Stack(w, stack->content[i].val.stack);
+    }
+}
+
+static uint64_t op_Index(operations op){
+    size_t i = 0;
+    while(INSTR_OP[i] != op)
+        i++;
+    return i;
+}
+
+static uint64_t brop_Index(br_operations brop){
+    size_t i = 0;
+    while(BR_INSTR_OP[i] != brop)
+        i++;
+    return i;
+}
+
+static uint64_t numop_Index(num_operations numop){
+    if(numop == numop_times)
+        return NUMOP_TIMES;
+    size_t i = 0;
+    while(NUM_INSTR_OP[i] != numop)
+        i++;
+    return i;
+}
+
+static void write_Code(struct ImageWriter *w, struct Code *code){
+    write_U64(w, code->srclen);
+    write_Bytes(w, code->src, code->srclen);
+    write_U64(w, code->size);
+    for(size_t i = 0; i < code->size; i++){
+        struct Instr *instr = &code->instrs[i];
+        struct ImageInstr rec;
+        memset(&rec, 0, sizeof(rec));
+        enum OpCode opcode = instr_OpCode(instr);
+        rec.opcode = opcode;
+        rec.tokentype = instr->token.type;
+        rec.tokenoff = instr->token.instr - code->src;
+        rec.info = instr->token.info;
+        rec.quote = code_Number(w, instr->quote);
+        // the unchecked and quickened opcodes have the arguments of their generic ones
+        enum OpCode generic = generic_OpCode(opcode);
+        switch(opcode){
+            case CallBrOp: case CallBrCode:
+                rec.arg[0] = brop_Index(instr->arg.brop);
+                break;
+            case CallCodeOp:
+                rec.arg[0] = brop_Index(instr->arg.brcode.brop);
+                break;
+            case CallBrNumOp:
+                rec.arg[0] = instr->arg.brnum.brop != NULL ? brop_Index(instr->arg.brnum.brop) + 1 : 0;
+                rec.arg[1] = numop_Index(instr->arg.brnum.numop);
+                rec.arg[2] = instr->arg.brnum.num;
+                break;
+            case CallNumOp:
+                rec.arg[0] = numop_Index(instr->arg.numop);
+                break;
+            default:
+                if(generic == CallOp || (generic >= OpSum && generic <= OpDip)){
+                    rec.arg[0] = op_Index(instr->arg.op);
+                }else if(opcode >= OpSumImm && opcode < End){
+                    rec.arg[0] = (uint64_t) instr->arg.fused.imm;
+                    rec.arg[1] = instr->arg.fused.num;
+                    rec.arg[2] = instr->arg.fused.lasttoken - code->src;
+                }
+        }
+        write_Bytes(w, &rec, sizeof(rec));
+    }
+}
+
+static void write_Stack(struct ImageWriter *w, struct Stack *stack){
+    write_U64(w, stack->next);
+    for(size_t i = 0; i < stack->next; i++){
+        struct StackElem *elem = &stack->content[i];
+        uint32_t type = elem->type;
+        write_Bytes(w, &type, sizeof(type));
+        switch(elem->type){
+            case String:
+            case Instruction:
+                write_U64(w, text_Len(elem));
+                write_Bytes(w, text_Elem(elem), text_Len(elem));
+                if(elem->type == Instruction)
+                    write_U64(w, code_Number(w, elem->code));
+                break;
+            case InnerStack:
+                write_Stack(w, elem->val.stack);
+                break;
+            default:
+                write_Bytes(w, &elem->val, sizeof(elem->val));
+        }
+    }
+}
+
+// the header, that identifies the build of sscript, followed by the collected codes
+static void write_Codes(struct ImageWriter *w, const char *magic, uint64_t srchash, uint64_t srclen){
+    struct ImageHeader header = {{0}, IMAGE_VERSION, End, OP_HASHED_SIZE, BROP_HASHED_SIZE, NUMOP_HASHED_SIZE,
+        sizeof(struct StackElem), w->size, srchash, srclen};
+    memcpy(header.magic, magic, sizeof(header.magic));
+    write_Bytes(w, &header, sizeof(header));
+    for(size_t i = 0; i < w->size; i++)
+        write_Code(w, w->codes[i]);
+}
+
+void dump_Image(struct ProgramState *state, char *path, struct ExceptionHandler *jbuff){
+    struct ImageWriter w = {fopen(path, "wb"), malloc(sizeof(struct Code *) * CODE_CAPACITY), 0, CODE_CAPACITY, NULL};
+    if(w.out == NULL){
+        if(w.codes != NULL)
+            free(w.codes);
+        RAISE(jbuff, FileNotCreatable);
+    }
+    if(w.codes == NULL){
+        fclose(w.out);
+        RAISE(jbuff, ProgramPanic);
+    }
+    struct ExceptionHandler *volatile wrerr = init_ExceptionHandler();
+    if(wrerr == NULL){
+        free(w.codes);
+        fclose(w.out);
+        RAISE(jbuff, ProgramPanic);
+    }
+    w.jbuff = wrerr;
+    TRY(wrerr){
+        size_t defined = 0;
+        for(size_t i = 0; i < state->env->capacity; i++){
+            if(state->env->content[i] != NULL){
+                collect_Code(&w, state->env->content[i]);
+                defined += 1;
+            }
+        }
+        collect_Stack(&w, state->stack);
+        write_Codes(&w, IMAGE_MAGIC, 0, 0);
+        write_U64(&w, defined);
+        for(size_t i = 0; i < state->env->capacity; i++){
+            if(state->env->content[i] != NULL){
+                write_U64(&w, strlen(symbols.names[i]));
+                write_Bytes(&w, symbols.names[i], strlen(symbols.names[i]));
+                write_U64(&w, code_Number(&w, state->env->content[i]));
+            }
+        }
+        write_Stack(&w, state->stack);
+    }CATCHALL{
+        uint32_t error = wrerr->exit_value;
+        free(w.codes);
+        fclose(w.out);
+        free_ExceptionHandler(wrerr);
+        RAISE(jbuff, error);
+    }
+    free(w.codes);
+    free_ExceptionHandler(wrerr);
+    if(fclose(w.out) != 0)
+        RAISE(jbuff, IOError);
+}
+
+struct ImageReader{
+    const char *data;
+    size_t size;
+    size_t pos;
+    struct Code **codes;
+    size_t ncodes;
+    struct ExceptionHandler *jbuff;
+};
+
+static const void *read_Bytes(struct ImageReader *r, size_t len){
+    if(len > r->size - r->pos)
+        RAISE(r->jbuff, IOError);
+    const void *res = r->data + r->pos;
+    r->pos += len;
+    return res;
+}
+
+static uint64_t read_U64(struct ImageReader *r){
+    uint64_t val;
+    memcpy(&val, read_Bytes(r, sizeof(val)), sizeof(val));
+    return val;
+}
+
+// number saved by code_Number, 0 is NULL
+static struct Code *read_CodeRef(struct ImageReader *r, uint64_t number, size_t loaded){
+    if(number > loaded)
+        RAISE(r->jbuff, IOError);
+    return number == 0 ? NULL : r->codes[number - 1];
+}
+
+static void read_Instr(struct ImageReader *r, struct Code *code, struct Instr *instr, size_t loaded){
+    struct ImageInstr rec;
+    memcpy(&rec, read_Bytes(r, sizeof(rec)), sizeof(rec));
+    if(rec.opcode >= End || rec.tokenoff > code->srclen)
+        RAISE(r->jbuff, IOError);
+    instr->opcode = rec.opcode;
+    instr->token.type = rec.tokentype;
+    instr->token.instr = code->src + rec.tokenoff;
+    instr->token.info = rec.info;
+    struct Code *quote = read_CodeRef(r, rec.quote, loaded);
+    enum OpCode generic = generic_OpCode(instr->opcode);
+    switch(instr->opcode){
+        case CallBrOp: case CallBrCode:
+            if(rec.arg[0] >= BROP_HASHED_SIZE)
+                RAISE(r->jbuff, IOError);
+            instr->arg.brop = BR_INSTR_OP[rec.arg[0]];
+            break;
+        case CallCodeOp:
+            if(rec.arg[0] >= BROP_HASHED_SIZE)
+                RAISE(r->jbuff, IOError);
+            instr->arg.brcode.brop = BR_INSTR_OP[rec.arg[0]];
+            instr->arg.brcode.codeop = bracket_CodeOp(instr->arg.brcode.brop);
+            if(instr->arg.brcode.codeop == NULL)
+                RAISE(r->jbuff, IOError);
+            break;
+        case CallBrNumOp:
+            if(rec.arg[0] > BROP_HASHED_SIZE || rec.arg[1] > NUMOP_TIMES)
+                RAISE(r->jbuff, IOError);
+            instr->arg.brnum.brop = rec.arg[0] != 0 ? BR_INSTR_OP[rec.arg[0] - 1] : NULL;
+            instr->arg.brnum.numop = rec.arg[1] == NUMOP_TIMES ? numop_times : NUM_INSTR_OP[rec.arg[1]];
+            instr->arg.brnum.num = rec.arg[2];
+            break;
+        case CallNumOp:
+            if(rec.arg[0] >= NUMOP_HASHED_SIZE)
+                RAISE(r->jbuff, IOError);
+            instr->arg.numop = NUM_INSTR_OP[rec.arg[0]];
+            break;
+        case CallWord:
+            atomic_init(&instr->arg.word.code, NULL);
+            atomic_init(&instr->arg.word.generation, 0);
+            if(rec.tokenoff + rec.info.stringlen > code->srclen)
+                RAISE(r->jbuff, IOError);
+            instr->arg.word.symbol = intern_Symbol(instr->token.instr, instr->token.info.stringlen);
+            if(instr->arg.word.symbol == SYMBOL_ERROR)
+                RAISE(r->jbuff, ProgramPanic);
+            break;
+        default:
+            if(generic == CallOp || (generic >= OpSum && generic <= OpDip)){
+                if(rec.arg[0] >= OP_HASHED_SIZE)
+                    RAISE(r->jbuff, IOError);
+                instr->arg.op = INSTR_OP[rec.arg[0]];
+            }else if(instr->opcode >= OpSumImm){
+                if(rec.arg[2] > code->srclen)
+                    RAISE(r->jbuff, IOError);
+                instr->arg.fused.imm = (int64_t) rec.arg[0];
+                instr->arg.fused.num = rec.arg[1];
+                instr->arg.fused.lasttoken = code->src + rec.arg[2];
+            }
+    }
+    instr->quote = retain_Code(quote);
+}
+
+static struct Code *read_Code(struct ImageReader *r){
+    uint64_t srclen = read_U64(r);
+    const char *src = read_Bytes(r, srclen);
+    struct Code *code = new_Code((char *) src, srclen);
+    if(code == NULL)
+        RAISE(r->jbuff, ProgramPanic);
+    r->codes[r->ncodes] = code;
+    r->ncodes += 1;
+    uint64_t size = read_U64(r);
+    if(size > (r->size - r->pos) / sizeof(struct ImageInstr))
+        RAISE(r->jbuff, IOError);
+    if(size + 1 > code->capacity){
+        struct Instr *newmem = realloc(code->instrs, sizeof(struct Instr) * (size + 1));
+        if(newmem == NULL)
+            RAISE(r->jbuff, ProgramPanic);
+        code->instrs = newmem;
+        code->capacity = size + 1;
+    }
+    for(size_t i = 0; i < size; i++){
+        code->size = i;
+        read_Instr(r, code, &code->instrs[i], r->ncodes - 1);
+    }
+    code->size = size;
+    struct Instr *end = &code->instrs[size];
+    end->opcode = End;
+    end->token.type = ErrorToken;
+    end->token.instr = code->src + srclen;
+    end->quote = NULL;
+    return code;
+}
+
+static void read_Stack(struct ImageReader *r, struct Stack *stack){
+    uint64_t count = read_U64(r);
+    for(size_t i = 0; i < count; i++){
+        uint32_t type;
+        memcpy(&type, read_Bytes(r, sizeof(type)), sizeof(type));
+        struct StackElem elem;
+        elem.type = type;
+        elem.code = NULL;
+        if(type == String || type == Instruction){
+            uint64_t len = read_U64(r);
+            const char *text = read_Bytes(r, len);
+            struct Code *code = NULL;
+            if(type == Instruction)
+                code = read_CodeRef(r, read_U64(r), r->ncodes);
+            if(!set_Text(&elem, text, len))
+                RAISE(r->jbuff, ProgramPanic);
+            elem.code = retain_Code(code);
+        }else if(type == InnerStack){
+            elem = new_Stack(r->jbuff);
+            push_Stack(stack, elem, r->jbuff);
+            read_Stack(r, elem.val.stack);
+            continue;
+        }else if(type <= None){
+            memcpy(&elem.val, read_Bytes(r, sizeof(elem.val)), sizeof(elem.val));
+        }else{
+            RAISE(r->jbuff, IOError);
+        }
+        push_Stack(stack, elem, r->jbuff);
+    }
+}
+
+static void read_Codes(struct ImageReader *r, const char *magic, uint64_t srchash, uint64_t srclen){
+    struct ImageHeader header;
+    memcpy(&header, read_Bytes(r, sizeof(header)), sizeof(header));
+    if(memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != IMAGE_VERSION
+            || header.opcodes != End || header.ops != OP_HASHED_SIZE || header.brops != BROP_HASHED_SIZE
+            || header.numops != NUMOP_HASHED_SIZE || header.elemsize != sizeof(struct StackElem)
+            || header.srchash != srchash || header.srclen != srclen)
+        RAISE(r->jbuff, IOError);
+    if(header.codes > r->size / sizeof(uint64_t))
+        RAISE(r->jbuff, IOError);
+    r->codes = malloc(sizeof(struct Code *) * (header.codes + 1));
+    if(r->codes == NULL)
+        RAISE(r->jbuff, ProgramPanic);
+    for(size_t i = 0; i < header.codes; i++)
+        read_Code(r);
+}
+
+static void read_Image(struct ProgramState *state, struct ImageReader *r){
+    read_Codes(r, IMAGE_MAGIC, 0, 0);
+    uint64_t defined = read_U64(r);
+    for(size_t i = 0; i < defined; i++){
+        uint64_t namelen = read_U64(r);
+        const char *name = read_Bytes(r, namelen);
+        struct Code *code = read_CodeRef(r, read_U64(r), r->ncodes);
+        uint32_t symbol = intern_Symbol(name, namelen);
+        if(symbol == SYMBOL_ERROR || code == NULL)
+            RAISE(r->jbuff, symbol == SYMBOL_ERROR ? ProgramPanic : IOError);
+        set_word(state->env, symbol, retain_Code(code), r->jbuff);
+    }
+    atomic_fetch_add_explicit(&definition_generation, 1, memory_order_release);
+    read_Stack(r, state->stack);
+}
+
+static uint32_t map_File(struct ImageReader *r, char *path){
+#if defined(__unix__)
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return FileNotFound;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        close(fd);
+        return IOError;
+    }
+    r->size = st.st_size;
+    void *mapped = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+        return IOError;
+    r->data = mapped;
+#else
+    FILE *in = fopen(path, "rb");
+    if(in == NULL)
+        return FileNotFound;
+    fseek(in, 0, SEEK_END);
+    long flen = ftell(in);
+    char *content = flen > 0 ? malloc(flen) : NULL;
+    rewind(in);
+    if(content == NULL || fread(content, 1, flen, in) != (size_t) flen){
+        if(content != NULL)
+            free(content);
+        fclose(in);
+        return IOError;
+    }
+    fclose(in);
+    r->size = flen;
+    r->data = content;
+#endif
+    return ProgramOk;
+}
+
+// the codes are owned by who retained them now, the ones that were not used are freed
+static void close_Reader(struct ImageReader *r){
+    for(size_t i = 0; i < r->ncodes; i++)
+        release_Code(r->codes[i]);
+    if(r->codes != NULL)
+        free(r->codes);
+#if defined(__unix__)
+    munmap((void *) r->data, r->size);
+#else
+    free((void *) r->data);
+#endif
+}
+
+void load_Image(struct ProgramState *state, char *path, struct ExceptionHandler *jbuff){
+    struct ImageReader r = {NULL, 0, 0, NULL, 0, NULL};
+    uint32_t error = map_File(&r, path);
+    if(error != ProgramOk)
+        RAISE(jbuff, error);
+    struct ExceptionHandler *volatile rderr = init_ExceptionHandler();
+    if(rderr != NULL){
+        r.jbuff = rderr;
+        TRY(rderr){
+            read_Image(state, &r);
+        }
+    }
+    error = rderr != NULL ? rderr->exit_value : ProgramPanic;
+    close_Reader(&r);
+    if(rderr != NULL)
+        free_ExceptionHandler(rderr);
+    if(error != ProgramOk)
+        RAISE(jbuff, error);
+}
+
+#define CACHE_HASHKEY0 0x736b73635f6b6579ULL
+#define CACHE_HASHKEY1 0x0123456789abcdefULL
+
+uint64_t source_Hash(const char *src, size_t len){
+    return SipHash_2_4(CACHE_HASHKEY0, CACHE_HASHKEY1, src, len);
+}
+
+// path.sksc for path.sksp, in SSCRIPT_CACHE_DIR if it's set
+char *cache_Path(const char *path){
+    const char *dir = getenv("SSCRIPT_CACHE_DIR");
+    size_t len = strlen(path);
+    char *res;
+    if(dir != NULL && dir[0] != '\0'){
+        res = malloc(strlen(dir) + 1 + 16 + 6);
+        if(res != NULL)
+            sprintf(res, "%s/%016llx.sksc", dir, (unsigned long long) source_Hash(path, len));
+        return res;
+    }
+    if(len >= 5 && strcmp(path + len - 5, ".sksp") == 0)
+        len -= 5;
+    res = malloc(len + 6);
+    if(res != NULL){
+        memcpy(res, path, len);
+        strcpy(res + len, ".sksc");
+    }
+    return res;
+}
+
+struct Code *load_CodeCache(char *cachepath, uint64_t srchash, size_t srclen){
+    struct ImageReader r = {NULL, 0, 0, NULL, 0, NULL};
+    if(map_File(&r, cachepath) != ProgramOk)
+        return NULL;
+    struct Code *volatile code = NULL;
+    struct ExceptionHandler *volatile rderr = init_ExceptionHandler();
+    if(rderr != NULL){
+        r.jbuff = rderr;
+        TRY(rderr){
+            read_Codes(&r, CACHE_MAGIC, srchash, srclen);
+            if(r.ncodes > 0)
+                code = retain_Code(r.codes[r.ncodes - 1]);
+        }
+        free_ExceptionHandler(rderr);
+    }
+    close_Reader(&r);
+    return code;
+}
+
+// written to a temporary file and then renamed, so that a cache being written is never read
+void save_CodeCache(struct Code *code, char *cachepath, uint64_t srchash){
+    size_t len = strlen(cachepath);
+    char *tmppath = malloc(len + 32);
+    if(tmppath == NULL)
+        return;
+#if defined(__unix__)
+    sprintf(tmppath, "%s.%ld.tmp", cachepath, (long) getpid());
+#else
+    sprintf(tmppath, "%s.tmp", cachepath);
+#endif
+    struct ImageWriter w = {fopen(tmppath, "wb"), malloc(sizeof(struct Code *) * CODE_CAPACITY), 0, CODE_CAPACITY, init_ExceptionHandler()};
+    volatile int saved = 0;
+    if(w.out != NULL && w.codes != NULL && w.jbuff != NULL){
+        TRY(w.jbuff){
+            collect_Code(&w, code);
+            write_Codes(&w, CACHE_MAGIC, srchash, code->srclen);
+            saved = 1;
+        }
+    }
+    if(w.codes != NULL)
+        free(w.codes);
+    if(w.jbuff != NULL)
+        free_ExceptionHandler(w.jbuff);
+    if(w.out != NULL){
+        if(fclose(w.out) != 0)
+            saved = 0;
+        if(!saved || rename(tmppath, cachepath) != 0)
+            remove(tmppath);
+    }
+    free(tmppath);
+}
@@ -0,0 +1,21 @@
+#ifndef SSCRIPT_IMAGE_H
+#define SSCRIPT_IMAGE_H
+#include "compiler.h"
+
+// An image is a snapshot of the definitions and of the stack of a ProgramState, with all their
+// compiled code: loading it gives back the same state without parsing anything.
+// Builtins are saved as indexes in their tables and symbols by name, so the image can be loaded
+// by any run of the same build of sscript.
+
+void dump_Image(struct ProgramState *state, char *path, struct ExceptionHandler *jbuff);
+void load_Image(struct ProgramState *state, char *path, struct ExceptionHandler *jbuff);
+
+// The compiled code of the files loaded by brop_load is cached in the same format. The cache is
+// valid only for the same build and for a source with the same hash and length, otherwise it's ignored
+
+uint64_t source_Hash(const char *src, size_t len);
+char *cache_Path(const char *path);
+struct Code *load_CodeCache(char *cachepath, uint64_t srchash, size_t srclen);
+void save_CodeCache(struct Code *code, char *cachepath, uint64_t srchash);
+
+#endif
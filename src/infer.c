@@ -0,0 +1,227 @@
+#include "infer.h"
+
+#define INT_TYPE TYPE_BIT(Integer)
+#define FLOAT_TYPE TYPE_BIT(Floating)
+#define BOOL_TYPE TYPE_BIT(Boolean)
+#define NO_TYPE ((TypeSet) 0)
+
+// builtins with a fixed stack effect, the others (apply, clear, roll, try...) are not followed
+static const struct OpSignature OP_SIGNATURE[] = {
+    {op_size, 0, 1, INT_TYPE}, {op_int, 1, 1, INT_TYPE},
+    {op_sum, 2, 1, ARITH_TYPE}, {op_sub, 2, 1, ARITH_TYPE}, {op_mul, 2, 1, ARITH_TYPE},
+    {op_div, 2, 1, FLOAT_TYPE}, {op_mod, 2, 1, INT_TYPE}, {op_pow, 2, 1, FLOAT_TYPE},
+    {op_opposite, 1, 1, ARITH_TYPE},
+    {op_sqrt, 1, 1, FLOAT_TYPE}, {op_exp, 1, 1, FLOAT_TYPE},
+    {op_log, 1, 1, FLOAT_TYPE}, {op_log2, 1, 1, FLOAT_TYPE}, {op_log10, 1, 1, FLOAT_TYPE},
+    {op_sin, 1, 1, FLOAT_TYPE}, {op_cos, 1, 1, FLOAT_TYPE}, {op_tan, 1, 1, FLOAT_TYPE},
+    {op_arcsin, 1, 1, FLOAT_TYPE}, {op_arccos, 1, 1, FLOAT_TYPE}, {op_arctan, 1, 1, FLOAT_TYPE},
+    {op_sinh, 1, 1, FLOAT_TYPE}, {op_cosh, 1, 1, FLOAT_TYPE}, {op_tanh, 1, 1, FLOAT_TYPE},
+    {op_arcsinh, 1, 1, FLOAT_TYPE}, {op_arccosh, 1, 1, FLOAT_TYPE}, {op_arctanh, 1, 1, FLOAT_TYPE},
+    {op_factorial, 1, 1, FLOAT_TYPE}, {op_gamma, 1, 1, FLOAT_TYPE},
+    {op_true, 0, 1, BOOL_TYPE}, {op_false, 0, 1, BOOL_TYPE}, {op_empty, 0, 1, BOOL_TYPE},
+    {op_not, 1, 1, BOOL_TYPE}, {op_and, 2, 1, BOOL_TYPE}, {op_or, 2, 1, BOOL_TYPE}, {op_xor, 2, 1, BOOL_TYPE},
+    {op_lower, 2, 1, BOOL_TYPE}, {op_greather, 2, 1, BOOL_TYPE},
+    {op_lowereq, 2, 1, BOOL_TYPE}, {op_greathereq, 2, 1, BOOL_TYPE},
+    {op_none, 0, 1, TYPE_BIT(None)}, {op_stack, 0, 1, TYPE_BIT(InnerStack)}, {op_top, 0, 1, ANY_TYPE},
+    {op_drop, 1, 0, NO_TYPE}, {op_nop, 0, 0, NO_TYPE}, {op_print, 0, 0, NO_TYPE}, {op_printall, 0, 0, NO_TYPE},
+    {op_compose, 2, 1, TYPE_BIT(Instruction) | TYPE_BIT(String)},
+    {op_type, 0, 1, TYPE_BIT(Type)},
+    {op_INSTR, 0, 1, TYPE_BIT(Type)}, {op_INT, 0, 1, TYPE_BIT(Type)}, {op_FLOAT, 0, 1, TYPE_BIT(Type)},
+    {op_BOOL, 0, 1, TYPE_BIT(Type)}, {op_STR, 0, 1, TYPE_BIT(Type)}, {op_TYPE, 0, 1, TYPE_BIT(Type)},
+    {op_NONE, 0, 1, TYPE_BIT(Type)}, {op_STACK, 0, 1, TYPE_BIT(Type)}
+};
+#define SIGNATURE_SIZE (sizeof(OP_SIGNATURE) / sizeof(OP_SIGNATURE[0]))
+
+const struct OpSignature *op_Signature(operations op){
+    for(size_t i = 0; i < SIGNATURE_SIZE; i++){
+        if(OP_SIGNATURE[i].op == op)
+            return &OP_SIGNATURE[i];
+    }
+    return NULL;
+}
+
+#define INFER_DEPTH 32
+
+// types of the elements on top of the stack, all of them are known to be there: an element can
+// be ANY_TYPE when an instruction that ran before proved only that it exists
+struct TypeStack{
+    TypeSet types[INFER_DEPTH];
+    size_t size;
+};
+
+static inline void push_Type(struct TypeStack *ts, TypeSet type){
+    if(ts->size == INFER_DEPTH){
+        memmove(ts->types, ts->types + 1, sizeof(TypeSet) * (INFER_DEPTH - 1));
+        ts->size -= 1;
+    }
+    ts->types[ts->size] = type;
+    ts->size += 1;
+}
+
+static inline void pop_Types(struct TypeStack *ts, size_t n){
+    ts->size = n < ts->size ? ts->size - n : 0;
+}
+
+// type of the n-th element from the top, starting from 1
+static inline TypeSet peek_Type(struct TypeStack *ts, size_t n){
+    return n <= ts->size ? ts->types[ts->size - n] : ANY_TYPE;
+}
+
+static inline int proven(struct TypeStack *ts, size_t n, TypeSet type){
+    return n <= ts->size && ts->types[ts->size - n] == type;
+}
+
+// the n-th element is known not to be an inner stack: == and != keep their inner stack operands
+// under the result, they pop their operands only when none of them is an inner stack
+static inline int scalar(struct TypeStack *ts, size_t n){
+    return n <= ts->size && (ts->types[ts->size - n] & TYPE_BIT(InnerStack)) == 0;
+}
+
+static inline TypeSet arith_Type(struct TypeStack *ts, size_t in){
+    TypeSet res = INT_TYPE;
+    for(size_t i = 1; i <= in; i++){
+        TypeSet type = peek_Type(ts, i);
+        if(type == FLOAT_TYPE)
+            return FLOAT_TYPE;
+        if(type != INT_TYPE)
+            res = INT_TYPE | FLOAT_TYPE;
+    }
+    return res;
+}
+
+static inline void apply_Signature(struct TypeStack *ts, size_t in, size_t out, TypeSet result){
+    if(result == ARITH_TYPE)
+        result = arith_Type(ts, in);
+    pop_Types(ts, in);
+    for(size_t i = 0; i < out; i++)
+        push_Type(ts, result);
+}
+
+static atomic_size_t unchecked_count;
+
+static inline void set_Unchecked(struct Instr *instr, enum OpCode opcode){
+    instr->opcode = opcode;
+    atomic_fetch_add_explicit(&unchecked_count, 1, memory_order_relaxed);
+}
+
+void infer_Code(struct Code *code){
+    struct TypeStack ts;
+    ts.size = 0;
+    for(size_t i = 0; i < code->size; i++){
+        struct Instr *instr = &code->instrs[i];
+        switch(instr->opcode){
+            case PushInt:
+                push_Type(&ts, INT_TYPE);
+                break;
+            case PushFloat:
+                push_Type(&ts, FLOAT_TYPE);
+                break;
+            case PushBool:
+                push_Type(&ts, BOOL_TYPE);
+                break;
+            case PushString:
+                push_Type(&ts, TYPE_BIT(String));
+                break;
+            case PushQuote:
+                push_Type(&ts, TYPE_BIT(Instruction));
+                break;
+            case PushStack:
+                push_Type(&ts, TYPE_BIT(InnerStack));
+                break;
+            case CallOp: {
+                const struct OpSignature *sig = op_Signature(instr->arg.op);
+                if(sig != NULL)
+                    apply_Signature(&ts, sig->in, sig->out, sig->result);
+                else
+                    ts.size = 0;
+                break;
+            }
+            case OpSum: case OpSub: case OpMul:
+                if(proven(&ts, 1, INT_TYPE) && proven(&ts, 2, INT_TYPE))
+                    set_Unchecked(instr, OpSumInt + (instr->opcode - OpSum));
+                apply_Signature(&ts, 2, 1, ARITH_TYPE);
+                break;
+            case OpLower: case OpGreather: case OpLowerEq: case OpGreatherEq:
+                if(proven(&ts, 1, INT_TYPE) && proven(&ts, 2, INT_TYPE))
+                    set_Unchecked(instr, OpSumInt + (instr->opcode - OpSum));
+                apply_Signature(&ts, 2, 1, BOOL_TYPE);
+                break;
+            case OpEqual: case OpNotEqual:
+                if(proven(&ts, 1, INT_TYPE) && proven(&ts, 2, INT_TYPE))
+                    set_Unchecked(instr, OpSumInt + (instr->opcode - OpSum));
+                if(scalar(&ts, 1) && scalar(&ts, 2))
+                    apply_Signature(&ts, 2, 1, BOOL_TYPE);
+                else
+                    ts.size = 0;
+                break;
+            case OpNot:
+                if(proven(&ts, 1, BOOL_TYPE))
+                    set_Unchecked(instr, OpNotBool);
+                apply_Signature(&ts, 1, 1, BOOL_TYPE);
+                break;
+            case OpAnd: case OpOr:
+                if(proven(&ts, 1, BOOL_TYPE) && proven(&ts, 2, BOOL_TYPE))
+                    set_Unchecked(instr, OpSumInt + (instr->opcode - OpSum));
+                apply_Signature(&ts, 2, 1, BOOL_TYPE);
+                break;
+            // left checked: their type test is always predicted and the unchecked versions measured slower
+            case OpSumImm: case OpSubImm: case OpMulImm:
+                apply_Signature(&ts, 1, 1, ARITH_TYPE);
+                break;
+            case OpLowerImm: case OpGreatherImm: case OpLowerEqImm: case OpGreatherEqImm:
+                if(proven(&ts, 1, INT_TYPE))
+                    set_Unchecked(instr, OpLowerImmInt + (instr->opcode - OpLowerImm));
+                apply_Signature(&ts, 1, 1, BOOL_TYPE);
+                break;
+            case OpEqualImm: case OpNotEqualImm:
+                if(proven(&ts, 1, INT_TYPE))
+                    set_Unchecked(instr, OpLowerImmInt + (instr->opcode - OpLowerImm));
+                if(scalar(&ts, 1))
+                    apply_Signature(&ts, 1, 1, BOOL_TYPE);
+                else
+                    ts.size = 0;
+                break;
+            case OpDup: {
+                TypeSet type = peek_Type(&ts, 1);
+                pop_Types(&ts, 1);
+                push_Type(&ts, type);
+                push_Type(&ts, type);
+                break;
+            }
+            case OpSwap: {
+                TypeSet first = peek_Type(&ts, 1);
+                TypeSet second = peek_Type(&ts, 2);
+                pop_Types(&ts, 2);
+                push_Type(&ts, first);
+                push_Type(&ts, second);
+                break;
+            }
+            case OpDrop:
+                pop_Types(&ts, 1);
+                break;
+            case OpSquare:
+                apply_Signature(&ts, 1, 1, ARITH_TYPE);
+                break;
+            case OpSwapSub:
+                apply_Signature(&ts, 2, 1, ARITH_TYPE);
+                break;
+            case OpSizeGreatherImm:
+                push_Type(&ts, BOOL_TYPE);
+                break;
+            case OpIf:
+                if(proven(&ts, 1, TYPE_BIT(Instruction)) && proven(&ts, 2, TYPE_BIT(Instruction)) && proven(&ts, 3, BOOL_TYPE))
+                    set_Unchecked(instr, OpIfBool);
+                ts.size = 0;
+                break;
+            case OpNop:
+                break;
+            default:
+                // words, quotations and bracket instructions can leave anything on the stack
+                ts.size = 0;
+        }
+    }
+}
+
+void print_inference(){
+    printf("checks elided\t\t%zu\n", atomic_load(&unchecked_count));
+}
@@ -0,0 +1,28 @@
+#ifndef SSCRIPT_INFER_H
+#define SSCRIPT_INFER_H
+#include "compiler.h"
+
+// set of the types that a stack element can have, a bit for every ElemType
+typedef uint8_t TypeSet;
+
+#define TYPE_BIT(type) ((TypeSet) 1 << (type))
+#define ANY_TYPE ((TypeSet) 0xff)
+// result of the arithmetic builtins: Integer when all the operands are, Floating when one of them is
+#define ARITH_TYPE ((TypeSet) 0)
+
+// stack effect of a builtin: it pops in elements and pushes out elements of type result
+struct OpSignature{
+	operations op;
+	uint8_t in;
+	uint8_t out;
+	TypeSet result;
+};
+
+const struct OpSignature *op_Signature(operations op);
+
+// Follows the types of the elements pushed by code and rewrites the instructions whose operands
+// are proven to their unchecked opcode. Elements under the ones code pushed are never known.
+void infer_Code(struct Code *code);
+void print_inference();
+
+#endif
@@ -2,21 +2,19 @@
 // Created by P4o1o on 14/05/2024.
 //
 #include "interpreter.h"
+#include "compiler.h"
+#include "builtins_hash.h"
+#include "image.h"
 #include <math.h>
 #include <errno.h>
 
-#define INNER_STACK_CAPACITY 256
-
-#define NUMBERED_SIZE 5
 char *NUMBERED_INSTR[] = {
         "dup", "swap", "dig", "inject", "pinject"
 };
 const num_operations NUM_INSTR_OP[] = {
         numop_dup, numop_swap, numop_dig, numop_inject, numop_pinject
 };
-#define NUMOP_MAP_SIZE 16
 
-#define BRACKETS_SIZE 12
 char *BRACKETS_INSTR[] = {
         "load","if","save","compose",
         "delete","isdef","loop","split",
@@ -27,9 +25,10 @@ const br_operations BR_INSTR_OP[] ={
         brop_delete, brop_isdef, brop_loop, brop_split,
         brop_swap, brop_define, brop_dup, brop_times, brop_dig
 };
-#define BROP_MAP_SIZE 32
 
-#define INSTR_SIZE 74
+// bumped by every define and delete, invalidates the definitions cached by the compiled code
+atomic_size_t definition_generation = 1;
+
 char* INSTRUCTIONS[] = {
         "int", "clear", "quote", "<=", "dup",
         "or", "swap", "+", "and", "dip",
@@ -64,209 +63,108 @@ const operations INSTR_OP[] ={
         op_arccosh, op_arctanh, op_exp, op_opposite, op_factorial,
         op_gamma, op_log, op_log2, op_log10
 };
-#define OP_MAP_SIZE 128
-
-#define IS_INDENT(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n' || (c) == '\0')
-
-#define RESERVED_CHAR(c) (IS_INDENT(c) || (c) == '[' || (c) == ']' || (c) == '{' || (c) == '}' || (c) == '(' || (c) == ')' || (c) == '"')
-
-struct Builtins builtins;
-
-#define HASHKEY_OP0 0x734ad7e3439432a3ULL
-#define HASHKEY_OP1 0x54dc762ab02dc4deULL
-#define HASHKEY_BROP0 0x734ad7e3439432a3ULL
-#define HASHKEY_BROP1 0x54dc762ab02dc4deULL
-
-int init_builtins() {
-    builtins.op_map = malloc(OP_MAP_SIZE * sizeof(struct OperationElem*));
-    if (builtins.op_map == NULL)
+#define TABLE_SIZE(table) (sizeof(table) / sizeof(table[0]))
+
+_Static_assert(TABLE_SIZE(INSTRUCTIONS) == OP_HASHED_SIZE && TABLE_SIZE(INSTR_OP) == OP_HASHED_SIZE,
+        "builtins_hash.h is out of date, run make builtins");
+_Static_assert(TABLE_SIZE(BRACKETS_INSTR) == BROP_HASHED_SIZE && TABLE_SIZE(BR_INSTR_OP) == BROP_HASHED_SIZE,
+        "builtins_hash.h is out of date, run make builtins");
+_Static_assert(TABLE_SIZE(NUMBERED_INSTR) == NUMOP_HASHED_SIZE && TABLE_SIZE(NUM_INSTR_OP) == NUMOP_HASHED_SIZE,
+        "builtins_hash.h is out of date, run make builtins");
+
+// perfect hash generated by tools/gen_builtins_hash.py: every builtin has its own slot, so a lookup
+// is the hash of three chars and the length followed by a single comparison
+#define BUILTIN_HASH(key, keylen, P) \
+    (((unsigned char)(key)[0] * P##_HASH_A + (unsigned char)(key)[(keylen) / 2] * P##_HASH_B \
+    + (unsigned char)(key)[(keylen) - 1] * P##_HASH_C + (keylen) * P##_HASH_D) & P##_HASH_MASK)
+
+static inline size_t find_builtin(char *table[], const unsigned char slots[], size_t hash, const char *key, size_t keylen){
+    size_t index = slots[hash];
+    if (index == 0)
         return 0;
-    for (size_t i = 0; i < OP_MAP_SIZE; i++) {
-        builtins.op_map[i] = NULL;
-    }
-    for (size_t i = 0; i < INSTR_SIZE; i++) {
-        uint64_t index = SipHash_2_4(HASHKEY_OP0, HASHKEY_OP1, INSTRUCTIONS[i], strlen(INSTRUCTIONS[i])) & (OP_MAP_SIZE - 1);
-        struct OperationElem* elem = builtins.op_map[index];
-        while (elem != NULL) {
-            if (strcmp(INSTRUCTIONS[i], elem->key) == 0) {
-                return 0;
-            }
-            elem = elem->next;
-        }
-        elem = malloc(sizeof(struct OperationElem));
-        if (elem == NULL)
-            return 0;
-        elem->key = INSTRUCTIONS[i];
-        elem->op = INSTR_OP[i];
-        elem->next = builtins.op_map[index];
-        elem->key_len = strlen(elem->key);
-        builtins.op_map[index] = elem;
-    }
-
-    builtins.brop_map = malloc(BROP_MAP_SIZE * sizeof(struct BrOperationElem*));
-    if (builtins.brop_map == NULL)
+    const char *name = table[index - 1];
+    if (strncmp(name, key, keylen) != 0 || name[keylen] != '\0')
         return 0;
-    for (size_t i = 0; i < BROP_MAP_SIZE; i++) {
-        builtins.brop_map[i] = NULL;
-    }
-    for (size_t i = 0; i < BRACKETS_SIZE; i++) {
-        uint64_t index = SipHash_2_4(HASHKEY_BROP0, HASHKEY_BROP1, BRACKETS_INSTR[i], strlen(BRACKETS_INSTR[i])) & (BROP_MAP_SIZE - 1);
-        struct BrOperationElem* elem = builtins.brop_map[index];
-        while (elem != NULL) {
-            if (strcmp(BRACKETS_INSTR[i], elem->key) == 0) {
-                return 0;
-            }
-            elem = elem->next;
-        }
-        elem = malloc(sizeof(struct BrOperationElem));
-        if (elem == NULL)
-            return 0;
-        elem->key = BRACKETS_INSTR[i];
-        elem->brop = BR_INSTR_OP[i];
-        elem->next = builtins.brop_map[index];
-        elem->key_len = strlen(elem->key);
-        builtins.brop_map[index] = elem;
-    }
+    return index;
+}
 
-    builtins.numop_map = malloc(NUMOP_MAP_SIZE * sizeof(struct NumOperationElem*));
-    if (builtins.numop_map == NULL)
-        return 0;
-    for (size_t i = 0; i < NUMOP_MAP_SIZE; i++) {
-        builtins.numop_map[i] = NULL;
-    }
-    for (size_t i = 0; i < NUMBERED_SIZE; i++) {
-        uint64_t index = SipHash_2_4(HASHKEY_OP0, HASHKEY_OP1, NUMBERED_INSTR[i], strlen(NUMBERED_INSTR[i])) & (NUMOP_MAP_SIZE - 1);
-        struct NumOperationElem* elem = builtins.numop_map[index];
-        while (elem != NULL) {
-            if (strcmp(NUMBERED_INSTR[i], elem->key) == 0) {
-                return 0;
-            }
-            elem = elem->next;
-        }
-        elem = malloc(sizeof(struct NumOperationElem));
-        if (elem == NULL)
-            return 0;
-        elem->key = NUMBERED_INSTR[i];
-        elem->numop = NUM_INSTR_OP[i];
-        elem->next = builtins.numop_map[index];
-        elem->key_len = strlen(elem->key);
-        builtins.numop_map[index] = elem;
-    }
-    return 1;
+operations find_op(const char *key, size_t keylen) {
+    if (keylen == 0)
+        return NULL;
+    size_t index = find_builtin(INSTRUCTIONS, OP_SLOT, BUILTIN_HASH(key, keylen, OP), key, keylen);
+    return index != 0 ? INSTR_OP[index - 1] : NULL;
 }
 
-void free_builtins() {
-    for (size_t i = 0; i < OP_MAP_SIZE; i++) {
-        struct OperationElem* elem = builtins.op_map[i];
-        while (elem != NULL) {
-            struct OperationElem* temp = elem->next;
-            free(elem);
-            elem = temp;
-        }
-    }
-    free(builtins.op_map);
-
-    for (size_t i = 0; i < BROP_MAP_SIZE; i++) {
-        struct BrOperationElem* elem = builtins.brop_map[i];
-        while (elem != NULL) {
-            struct BrOperationElem* temp = elem->next;
-            free(elem);
-            elem = temp;
-        }
-    }
-    free(builtins.brop_map);
-
-    for (size_t i = 0; i < NUMOP_MAP_SIZE; i++) {
-        struct NumOperationElem* elem = builtins.numop_map[i];
-        while (elem != NULL) {
-            struct NumOperationElem* temp = elem->next;
-            free(elem);
-            elem = temp;
-        }
-    }
-    free(builtins.numop_map);
+br_operations find_brop(const char *key, size_t keylen) {
+    if (keylen == 0)
+        return NULL;
+    size_t index = find_builtin(BRACKETS_INSTR, BROP_SLOT, BUILTIN_HASH(key, keylen, BROP), key, keylen);
+    return index != 0 ? BR_INSTR_OP[index - 1] : NULL;
 }
 
-//---------------------------------------------------------------------------------------------------------------------------------------------------------
+num_operations find_numop(const char *key, size_t keylen) {
+    if (keylen == 0)
+        return NULL;
+    size_t index = find_builtin(NUMBERED_INSTR, NUMOP_SLOT, BUILTIN_HASH(key, keylen, NUMOP), key, keylen);
+    return index != 0 ? NUM_INSTR_OP[index - 1] : NULL;
+}
 
+//---------------------------------------------------------------------------------------------------------------------------------------------------------
 
-#define HASHKEY0 0x734bc7ed439782a3ULL
-#define HASHKEY1 0x542f7629b02ac4deULL
 
-static inline int set_Environment(struct Environment* env, char* key, size_t keylen, char* val, struct ExceptionHandler* jbuff) {
-    size_t index = (size_t)(SipHash_2_4(HASHKEY0, HASHKEY1, key, keylen) % env->capacity);
-    struct EnvElem* elem = env->content[index];
-    while (elem != NULL) {
-        if (keylen == strlen(elem->key) && strncmp(key, elem->key, keylen) == 0) {
-            free(elem->value);
-            elem->value = val;
-            return 1;
+void set_word(struct Environment* env, uint32_t symbol, struct Code* val, struct ExceptionHandler* jbuff) {
+    if (symbol >= env->capacity) {
+        size_t capacity = env->capacity * 2 > symbol ? env->capacity * 2 : (size_t)symbol + 1;
+        struct Code **newmem = realloc(env->content, sizeof(struct Code *) * capacity);
+        if (newmem == NULL) {
+            release_Code(val);
+            RAISE(jbuff, ProgramPanic);
+        }
+        for (size_t i = env->capacity; i < capacity; i++) {
+            newmem[i] = NULL;
         }
-        elem = elem->next;
+        env->content = newmem;
+        env->capacity = capacity;
     }
-    elem = malloc(sizeof(struct EnvElem));
-    if (elem == NULL)
-        RAISE(jbuff, ProgramPanic);
-    elem->key = malloc(keylen + 1);
-    if (elem->key == NULL)
-        RAISE(jbuff, ProgramPanic);
-    strncpy(elem->key, key, keylen);
-    elem->key[keylen] = '\0';
-    elem->value = val;
-    elem->next = env->content[index];
-    env->content[index] = elem;
-    return 0;
+    release_Code(env->content[symbol]);
+    env->content[symbol] = val;
 }
 
-static inline int get_Environment(struct Environment* env, const char* key, size_t keylen, char** out) {
-    size_t index = (size_t)(SipHash_2_4(HASHKEY0, HASHKEY1, key, keylen) % env->capacity);
-    struct EnvElem* elem = env->content[index];
-    while (elem != NULL) {
-        if (keylen == strlen(elem->key) && strncmp(key, elem->key, keylen) == 0) {
-            *out = elem->value;
-            return 1;
-        }
-        elem = elem->next;
-    }
-    return 0;
+struct Code *find_word(struct Environment *env, uint32_t symbol){
+    if (symbol >= env->capacity)
+        return NULL;
+    return env->content[symbol];
 }
 
-static inline int remove_Environment(struct Environment* env, const char* key, size_t keylen) {
-    size_t index = (size_t)(SipHash_2_4(HASHKEY0, HASHKEY1, key, keylen) % env->capacity);
-    struct EnvElem** elem_ptr = &env->content[index];
-    struct EnvElem* elem = *elem_ptr;
-    while (elem != NULL) {
-        if (keylen == strlen(elem->key) && strncmp(key, elem->key, keylen) == 0) {
-            free(elem->key);
-            free(elem->value);
-            *elem_ptr = elem->next;
-            free(elem);
-            return 1;
-        }
-        elem_ptr = &elem->next;
-        elem = *elem_ptr;
-    }
-    return 0;
+static inline void remove_Environment(struct Environment* env, uint32_t symbol) {
+    if (symbol >= env->capacity)
+        return;
+    release_Code(env->content[symbol]);
+    env->content[symbol] = NULL;
 }
 
-static inline void add_backtrace(struct ExceptionHandler *jbuff){
-    jbuff->bt_size += 1;
-    if(jbuff->bt_size >= jbuff->bt_capacity){
-        jbuff->bt_capacity *= 2;
-        jbuff->not_exec = realloc(jbuff->not_exec, sizeof(char *) * jbuff->bt_capacity);
+static inline struct OpenMemMap *new_OpenMem(struct ExceptionHandler *jbuff){
+    struct OpenMemMap *elem = jbuff->freemem;
+    if(elem != NULL){
+        jbuff->freemem = elem->next;
+        return elem;
     }
+    elem = alloc_Arena(&jbuff->arena, sizeof(struct OpenMemMap));
+    if (elem == NULL)
+        RAISE(jbuff, ProgramPanic);
+    return elem;
 }
 
-static inline void remove_backtrace(struct ExceptionHandler *jbuff){
-    jbuff->bt_size -= 1;
+static inline void free_OpenMem(struct ExceptionHandler *jbuff, struct OpenMemMap *elem){
+    elem->next = jbuff->freemem;
+    jbuff->freemem = elem;
 }
 
-static inline void add_memory(struct ExceptionHandler *jbuff, char *mem){
+static inline void add_memory(struct ExceptionHandler *jbuff, char *mem, struct Code *code){
     size_t index = ((size_t) mem) % OM_VEC_CAPACITY;
-    struct OpenMemMap *elem = malloc(sizeof(struct OpenMemMap));
-    if (elem == NULL)
-        RAISE(jbuff, ProgramPanic);
+    struct OpenMemMap *elem = new_OpenMem(jbuff);
     elem->openmem = mem;
+    elem->opencode = code;
     elem->next = jbuff->openmemmap[index];
     jbuff->openmemmap[index] = elem;
 }
@@ -278,8 +176,9 @@ static inline int remove_memory(struct ExceptionHandler *jbuff, char *mem){
     while (elem != NULL) {
         if (mem == elem->openmem) {
             free(mem);
+            release_Code(elem->opencode);
             *elem_ptr = elem->next;
-            free(elem);
+            free_OpenMem(jbuff, elem);
             return 1;
         }
         elem_ptr = &elem->next;
@@ -288,72 +187,74 @@ static inline int remove_memory(struct ExceptionHandler *jbuff, char *mem){
     return 0;
 }
 
-static inline struct StackElem new_Stack(struct ExceptionHandler *jbuff){
-    struct StackElem elem;
-    elem.type = InnerStack;
-    elem.val.stack = malloc(sizeof(struct Stack));
-    if(elem.val.stack == NULL)
-        RAISE(jbuff, ProgramPanic);
-    elem.val.stack->capacity = INNER_STACK_CAPACITY;
-    elem.val.stack->next = 0;
-    elem.val.stack->content = malloc(sizeof(struct StackElem) * elem.val.stack->capacity);
-    if(elem.val.stack->content == NULL)
-        RAISE(jbuff, ProgramPanic);
-    return elem;
+static inline void add_code(struct ExceptionHandler *jbuff, struct Code *code){
+    size_t index = ((size_t) code) % OM_VEC_CAPACITY;
+    struct OpenMemMap *elem = new_OpenMem(jbuff);
+    elem->openmem = NULL;
+    elem->opencode = code;
+    elem->next = jbuff->openmemmap[index];
+    jbuff->openmemmap[index] = elem;
+}
+
+static inline int remove_code(struct ExceptionHandler *jbuff, struct Code *code){
+    size_t index = ((size_t) code) % OM_VEC_CAPACITY;
+    struct OpenMemMap** elem_ptr = &jbuff->openmemmap[index];
+    struct OpenMemMap* elem = *elem_ptr;
+    while (elem != NULL) {
+        if (elem->openmem == NULL && code == elem->opencode) {
+            release_Code(code);
+            *elem_ptr = elem->next;
+            free_OpenMem(jbuff, elem);
+            return 1;
+        }
+        elem_ptr = &elem->next;
+        elem = *elem_ptr;
+    }
+    return 0;
 }
 
 //------------------------------------------------------------------------------------------------------
 
+void execute_word(struct ProgramState *state, char *name, size_t namelen, struct ExceptionHandler *jbuff){
+    struct Code* code = find_word(state->env, find_Symbol(name, namelen));
+    if (code == NULL)
+        RAISE(jbuff, InvalidInstruction);
+    add_code(jbuff, retain_Code(code));
+    add_backtrace(jbuff);
+    execute_code(state, code, jbuff);
+    remove_backtrace(jbuff);
+    remove_code(jbuff, code);
+}
+
 void execute_instr(struct ProgramState *state, struct Token *token, struct ExceptionHandler *jbuff){
     jbuff->not_exec[jbuff->bt_size - 1] = token->instr;
     struct StackElem elem;
-    size_t index;
-    char** funct;
+    operations op;
+    br_operations brop;
+    num_operations numop;
     switch (token->type){
         case StringToken:
             elem.type = String;
-            elem.val.instr = malloc(token->info.stringlen + 1);
-            if(elem.val.instr == NULL)
+            if(!set_Text(&elem, token->instr, token->info.stringlen))
                 RAISE(jbuff, ProgramPanic);
-            strncpy(elem.val.instr, token->instr, token->info.stringlen);
-            elem.val.instr[token->info.stringlen] = '\0';
             push_Stack(state->stack, elem, jbuff);
             break;
         
         case InstrToken:
             elem.type = Instruction;
-            elem.val.instr = malloc(token->info.stringlen + 1);
-            if(elem.val.instr == NULL)
+            if(!set_Text(&elem, token->instr, token->info.stringlen))
                 RAISE(jbuff, ProgramPanic);
-            strncpy(elem.val.instr, token->instr, token->info.stringlen);
-            elem.val.instr[token->info.stringlen] = '\0';
+            elem.code = NULL;
             push_Stack(state->stack, elem, jbuff);
             break;
         
         case BrInstrToken:
-            index = (size_t)(SipHash_2_4(HASHKEY_BROP0, HASHKEY_BROP1, token->instr, token->info.special.val) & (BROP_MAP_SIZE - 1));
-            struct BrOperationElem* bropelem = builtins.brop_map[index];
-            while (bropelem != NULL) {
-                if (strncmp(token->instr, bropelem->key, token->info.special.val) == 0 && token->info.special.val == bropelem->key_len) {
-                    bropelem->brop(state, token->instr + token->info.special.val + 1, token->info.special.instrlen, jbuff);
-                    return;
-                }
-                bropelem = bropelem->next;
-            }
-            funct = malloc(sizeof(char*));
-            if (funct == NULL)
-                RAISE(jbuff, ProgramPanic);
-            if (get_Environment(state->env, token->instr, token->info.stringlen, funct) == 1) {
-                char* text = *funct;
-                free(funct);
-                add_backtrace(jbuff);
-                parse_script(state, text, strlen(text), jbuff);
-                remove_backtrace(jbuff);
+            brop = find_brop(token->instr, token->info.special.val);
+            if (brop != NULL) {
+                brop(state, token->instr + token->info.special.val + 1, token->info.special.instrlen, jbuff);
                 return;
-            }else{
-                free(funct);
-                RAISE(jbuff, InvalidInstruction);
             }
+            execute_word(state, token->instr, token->info.stringlen, jbuff);
             break;
         
         case StackToken:
@@ -379,41 +280,22 @@ void execute_instr(struct ProgramState *state, struct Token *token, struct Excep
             push_Stack(state->stack, elem, jbuff);
             break;
         case NumInsrtToken:
-            index = (size_t)(SipHash_2_4(HASHKEY_BROP0, HASHKEY_BROP1, token->instr, token->info.special.instrlen) & (NUMOP_MAP_SIZE - 1));
-            struct NumOperationElem* numopelem = builtins.numop_map[index];
-            while (numopelem != NULL) {
-                if (strncmp(token->instr, numopelem->key, token->info.special.instrlen) == 0 && token->info.special.instrlen == numopelem->key_len) {
-                    numopelem->numop(state, token->info.special.val, jbuff);
-                    return;
-                }
-                numopelem = numopelem->next;
-            }
-            RAISE(jbuff, InvalidInstruction);
+            numop = find_numop(token->instr, token->info.special.instrlen);
+            if (numop == NULL)
+                RAISE(jbuff, InvalidInstruction);
+            numop(state, token->info.special.val, jbuff);
             break;
         case GenericToken:
-            index = (size_t)(SipHash_2_4(HASHKEY_OP0, HASHKEY_OP1, token->instr, token->info.stringlen) & (OP_MAP_SIZE - 1));
-            struct OperationElem* opelem = builtins.op_map[index];
-            while (opelem != NULL) {
-                if (strncmp(token->instr, opelem->key, token->info.stringlen) == 0 && token->info.stringlen == opelem->key_len) { // OP
-                    opelem->op(state, jbuff);
-                    return;
-                }
-                opelem = opelem->next;
-            }
-            funct = malloc(sizeof(char*));
-            if (funct == NULL)
-                RAISE(jbuff, ProgramPanic);
-            if (get_Environment(state->env, token->instr, token->info.stringlen, funct) == 1) {
-                char* text = *funct;
-                free(funct);
-                add_backtrace(jbuff);
-                parse_script(state, text, strlen(text), jbuff);
-                remove_backtrace(jbuff);
+            op = find_op(token->instr, token->info.stringlen);
+            if (op != NULL) {
+                op(state, jbuff);
                 return;
-            }else{
-                free(funct);
-                RAISE(jbuff, InvalidInstruction);
             }
+            execute_word(state, token->instr, token->info.stringlen, jbuff);
+            break;
+
+        case ErrorToken:
+            RAISE(jbuff, token->info.integer);
             break;
         
         default:
@@ -421,104 +303,155 @@ void execute_instr(struct ProgramState *state, struct Token *token, struct Excep
     }
 }
 
-struct Token stringToken(char *comand, size_t *clen, struct ExceptionHandler *jbuff){
+// the tokenizers get the slice of the source index starting at comand, the closing character must be
+// in the clen characters that are left
+struct Token stringToken(char *comand, size_t *clen, const struct SourceIndex *index, struct ExceptionHandler *jbuff){
     struct Token res;
     res.type = StringToken;
     res.instr = comand + 1;
-    for(size_t i = 1; i < *clen; i++){
-        if(comand[i] == '"'){
-            res.info.stringlen = i - 1;
-            *clen = i + 1;
-            return res;
-        }
-    }
-    RAISE(jbuff, StringQuotingError);
+    size_t match = index->match[0];
+    if(match == NO_MATCH || match >= *clen)
+        RAISE(jbuff, StringQuotingError);
+    res.info.stringlen = match - 1;
+    *clen = match + 1;
+    return res;
 }
 
-struct Token instrToken(char *comand, size_t *clen, struct ExceptionHandler *jbuff){
+struct Token instrToken(char *comand, size_t *clen, const struct SourceIndex *index, struct ExceptionHandler *jbuff){
     struct Token res;
     res.type = InstrToken;
     res.instr = comand + 1;
-    size_t count = 0;
-    for(size_t i = 1; i < *clen; i++){
-        if(comand[i] == ']'){
-            if(count == 0){
-                res.info.stringlen = i - 1;
-                *clen = i + 1;
-                return res;
-            }
-            count -= 1;
-        }else if(comand[i] == '['){
-            count += 1;
-        }
-    }
-    RAISE(jbuff, SquaredParenthesisError);
+    size_t match = index->match[0];
+    if(match == NO_MATCH || match >= *clen)
+        RAISE(jbuff, SquaredParenthesisError);
+    res.info.stringlen = match - 1;
+    *clen = match + 1;
+    return res;
 }
 
-struct Token stackToken(char *comand, size_t *clen, struct ExceptionHandler *jbuff){
+struct Token stackToken(char *comand, size_t *clen, const struct SourceIndex *index, struct ExceptionHandler *jbuff){
     struct Token res;
     res.type = StackToken;
     res.instr = comand + 1;
-    size_t count = 0;
-    for(size_t i = 1; i < *clen; i++){
-        if(comand[i] == '}'){
-            if(count == 0){
-                res.info.stringlen = i - 1;
-                *clen = i + 1;
-                return res;
-            }
-            count -= 1;
-        }else if(comand[i] == '{'){
-            count += 1;
-        }
+    size_t match = index->match[0];
+    if(match == NO_MATCH || match >= *clen)
+        RAISE(jbuff, CurlyParenthesisError);
+    res.info.stringlen = match - 1;
+    *clen = match + 1;
+    return res;
+}
+
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+// digits that always fit in an uint64_t
+#define MAX_MANTISSA_DIGITS 19
+#define MAX_EXACT_MANTISSA ((uint64_t) 1 << 53)
+
+// powers of ten represented exactly by a double
+static const double EXACT_POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#define MAX_EXACT_POW10 ((int64_t) (sizeof(EXACT_POW10) / sizeof(EXACT_POW10[0])) - 1)
+
+// value of the digits at *str saturated at UINT64_MAX, *str is moved after them and *sig is
+// the number of significant digits read (the ones after the leading zeros)
+static inline uint64_t read_Digits(char **str, size_t *sig){
+    uint64_t val = 0;
+    size_t n = 0;
+    char *c = *str;
+    for(; IS_DIGIT(*c); c++){
+        unsigned digit = (unsigned) (*c - '0');
+        val = val > (UINT64_MAX - digit) / 10 ? UINT64_MAX : val * 10 + digit;
+        n += val != 0;
     }
-    RAISE(jbuff, CurlyParenthesisError);
+    *str = c;
+    *sig = n;
+    return val;
 }
 
+// Reads the number in a single pass, without the locale: integers saturate like strtol, a '.'
+// or a ',' after the digits makes it a DecimalToken that ends where strtod in the C locale ends it.
+// The decimals whose digits fit in a double and whose power of ten is exact are computed with a
+// single correctly rounded operation, the others are left to strtod.
 struct Token numericToken(char *comand, size_t *clen, struct ExceptionHandler *jbuff){
     struct Token res;
-    char *endptr;
     res.instr = comand;
-    uint64_t intval = strtol(comand, &endptr, 10);
-    if(*endptr == '.' || *endptr == ','){
-        double dblval = strtod(comand, &endptr);
-        res.type = DecimalToken;
-        res.info.decimal = dblval;
-    }else{
+    char *c = comand;
+    int neg = *c == '-';
+    c += neg;
+    size_t sig;
+    uint64_t intval = read_Digits(&c, &sig);
+    if(*c != '.' && *c != ','){
         res.type = IntegerToken;
-        res.info.integer = intval;
+        if(neg)
+            res.info.integer = intval > (uint64_t) INT64_MAX ? INT64_MIN : -(int64_t) intval;
+        else
+            res.info.integer = intval > (uint64_t) INT64_MAX ? INT64_MAX : (int64_t) intval;
+        *clen = (size_t)(c - comand);
+        return res;
+    }
+    uint64_t mantissa = intval;
+    int exact = sig <= MAX_MANTISSA_DIGITS;
+    int64_t exp10 = 0;
+    if(*c == '.'){
+        for(c += 1; IS_DIGIT(*c); c++){
+            if(sig < MAX_MANTISSA_DIGITS){
+                mantissa = mantissa * 10 + (uint64_t) (*c - '0');
+                sig += mantissa != 0;
+                exp10 -= 1;
+            }else if(*c != '0'){
+                exact = 0;
+            }
+        }
+        char *e = c + 1;
+        if((*c == 'e' || *c == 'E') && ((*e == '-' || *e == '+') ? IS_DIGIT(e[1]) : IS_DIGIT(*e))){
+            int expneg = *e == '-';
+            e += *e == '-' || *e == '+';
+            int64_t expval = 0;
+            for(; IS_DIGIT(*e); e++){
+                if(expval < 100000)
+                    expval = expval * 10 + (*e - '0');
+            }
+            exp10 += expneg ? -expval : expval;
+            c = e;
+        }
     }
-    *clen = (size_t)(endptr - comand);
+    res.type = DecimalToken;
+    if(exact && mantissa <= MAX_EXACT_MANTISSA && exp10 >= -MAX_EXACT_POW10 && exp10 <= MAX_EXACT_POW10){
+        double val = exp10 < 0 ? (double) mantissa / EXACT_POW10[-exp10] : (double) mantissa * EXACT_POW10[exp10];
+        res.info.decimal = neg ? -val : val;
+    }else{
+        res.info.decimal = strtod(comand, NULL);
+    }
+    *clen = (size_t)(c - comand);
     return res;
 }
 
-struct Token scriptToken(char *comand, size_t *clen, struct ExceptionHandler *jbuff){
+struct Token scriptToken(char *comand, size_t *clen, const struct SourceIndex *index, struct ExceptionHandler *jbuff){
     struct Token res;
     res.type = GenericToken;
     res.instr = comand;
-    for(size_t i = 0; i < *clen; i++){
+    size_t i = next_Bit(index, index->stop, 1, 0, *clen);
+    if(i < *clen){
         if(IS_INDENT(comand[i])){
             res.info.stringlen = i;
             *clen = i + 1;
             return res;
         }else if(comand[i] == '('){
+            size_t match = index->match[i];
+            if(match == NO_MATCH || i + match >= *clen)
+                RAISE(jbuff, RoundParenthesisError);
             res.type = BrInstrToken;
             res.info.special.val = i;
-            i += 1;
-            while(i < *clen){
-                if(comand[i] == ')'){
-                    res.type = BrInstrToken;
-                    res.info.special.instrlen = i - 1 - res.info.special.val;
-                    *clen = i + 1;
-                    return res;
-                }
-                i += 1;
-            }
-            RAISE(jbuff, RoundParenthesisError);
+            res.info.special.instrlen = match - 1;
+            *clen = i + match + 1;
+            return res;
         }else if(comand[i] >= '0' && comand[i] <= '9'){
-            char *endptr;
+            char *endptr = comand + i;
+            size_t sig;
             res.info.stringlen = i;
-            res.info.special.val = strtol(comand + i, &endptr, 10);
+            uint64_t val = read_Digits(&endptr, &sig);
+            res.info.special.val = val > (uint64_t) INT64_MAX ? (size_t) INT64_MAX : (size_t) val;
             *clen = (size_t)(endptr - comand);
             res.type = NumInsrtToken;
             return res;
@@ -528,61 +461,71 @@ struct Token scriptToken(char *comand, size_t *clen, struct ExceptionHandler *jb
     return res;
 }
 
+int next_token(char *comands, size_t clen, size_t *pos, struct Token *token, const struct SourceIndex *index, struct ExceptionHandler *jbuff){
+    size_t i = *pos;
+    if(i < clen && IS_INDENT(comands[i]))
+        i = next_Bit(index, index->blank, 0, i, clen);
+    if(i >= clen){
+        *pos = i;
+        return 0;
+    }
+    size_t start = clen - i;
+    struct SourceIndex at = slice_Index(index, i);
+    if(comands[i] == '"'){
+        *token = stringToken(comands + i, &start, &at, jbuff);
+    }else if(comands[i] == '['){
+        *token = instrToken(comands + i, &start, &at, jbuff);
+    }else if(comands[i] == '{'){
+        *token = stackToken(comands + i, &start, &at, jbuff);
+    }else if(comands[i] >= '0' && comands[i] <='9'){
+        *token = numericToken(comands + i, &start, jbuff);
+    }else if(comands[i] == '-' && i + 1 < clen && comands[i + 1] >= '0' && comands[i + 1] <= '9'){
+        *token = numericToken(comands + i, &start, jbuff);
+    }else{
+        *token = scriptToken(comands + i, &start, &at, jbuff);
+    }
+    *pos = i + start;
+    return 1;
+}
+
 void parse_script(struct ProgramState *state, char *comands, size_t clen, struct ExceptionHandler *jbuff){
     jbuff->not_exec[jbuff->bt_size - 1] = comands;
+    struct SourceIndex index = index_Source(comands, clen);
+    if(index.match == NULL)
+        RAISE(jbuff, ProgramPanic);
+    add_memory(jbuff, (char *) index.match, NULL);
     struct Token token;
     size_t i = 0;
-    while(i < clen){
-        if(IS_INDENT(comands[i])){
-            i += 1;
-            continue;
-        }else if(comands[i] == '"'){
-            size_t start = clen - i;
-            token = stringToken(comands + i, &start, jbuff);
-            execute_instr(state, &token, jbuff);
-            i += start;
-        }else if(comands[i] == '['){
-            size_t start = clen - i;
-            token = instrToken(comands + i, &start, jbuff);
-            execute_instr(state, &token, jbuff);
-            i += start;
-        }else if(comands[i] == '{'){
-            size_t start = clen - i;
-            token = stackToken(comands + i, &start, jbuff);
-            execute_instr(state, &token, jbuff);
-            i += start;
-        }else if(comands[i] >= '0' && comands[i] <='9'){
-            size_t start = clen - i;
-            token = numericToken(comands + i, &start, jbuff);
-            execute_instr(state, &token, jbuff);
-            i += start;
-        }else if(comands[i] == '-'){
-            if(i + 1 < clen && comands[i + 1] >= '0' && comands[i + 1] <= '9'){
-                size_t start = clen - i;
-                token = numericToken(comands + i, &start, jbuff);
-                execute_instr(state, &token, jbuff);
-                i += start;
-            }else{
-                size_t start = clen - i;
-                token = scriptToken(comands + i, &start, jbuff);
-                execute_instr(state, &token, jbuff);
-                i += start;
-            }
-        }else{
-            size_t start = clen - i;
-            token = scriptToken(comands + i, &start, jbuff);
-            execute_instr(state, &token, jbuff);
-            i += start;
-        }
+    while(next_token(comands, clen, &i, &token, &index, jbuff)){
+        execute_instr(state, &token, jbuff);
     }
+    remove_memory(jbuff, (char *) index.match);
 }
 
 void execute(struct ProgramState *state, char *comands, struct ExceptionHandler *jbuff){
-    parse_script(state, comands, strlen(comands), jbuff);
+    struct Code *code = compile_script(comands, strlen(comands), jbuff);
+    add_code(jbuff, code);
+    execute_code(state, code, jbuff);
+    remove_code(jbuff, code);
 }
 
 //------------------------------------------------------------------------------------------------------
 
+// pushes the parts of string separated by the characters of delimiters, string isn't modified
+static inline void push_Tokens(struct ProgramState *state, struct StackElem *string, const char *delimiters, struct ExceptionHandler *jbuff){
+    char *token = text_Elem(string);
+    char *end = token + text_Len(string);
+    for(token += strspn(token, delimiters); token < end; token += strspn(token, delimiters)){
+        size_t tokenlen = strcspn(token, delimiters);
+        struct StackElem elem;
+        elem.type = String;
+        if (!set_Text(&elem, token, tokenlen))
+            RAISE(jbuff, ProgramPanic);
+        push_Stack(state->stack, elem, jbuff);
+        token += tokenlen;
+    }
+}
+
 void brop_split(struct ProgramState *state, char *comand, size_t clen, struct ExceptionHandler *jbuff){
     add_backtrace(jbuff);
     parse_script(state, comand, clen, jbuff);
@@ -594,20 +537,9 @@ void brop_split(struct ProgramState *state, char *comand, size_t clen, struct Ex
     state->stack->next -= 1;
     struct StackElem string = state->stack->content[state->stack->next];
     if(delimiter.type == String && string.type == String) {
-        char *token = strtok(string.val.instr, delimiter.val.instr);
-        do{
-            struct StackElem elem;
-            elem.type = String;
-            size_t tokenlen = strlen(token);
-            elem.val.instr = malloc(tokenlen + 1);
-             if (elem.val.instr == NULL)
-                RAISE(jbuff, ProgramPanic);
-            memcpy(elem.val.instr, token, tokenlen);
-            elem.val.instr[tokenlen] = '\0';
-            push_Stack(state->stack, elem, jbuff);
-        }while((token = strtok(NULL, delimiter.val.instr)) != NULL);
-        free(string.val.instr);
-        free(delimiter.val.instr);
+        push_Tokens(state, &string, text_Elem(&delimiter), jbuff);
+        release_Text(&string);
+        release_Text(&delimiter);
     }else{
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
@@ -624,7 +556,10 @@ void op_split(struct ProgramState* state, struct ExceptionHandler* jbuff){
         size_t round_br = 0;
         short string = 0;
         size_t i = 0;
-        char *original = state->stack->content[state->stack->next].val.instr;
+        // the pushes can move the stack, and an inline text with it
+        struct StackElem quot = state->stack->content[state->stack->next];
+        char *original = text_Elem(&quot);
+        struct Code *origcode = quot.code;
         for(; original[i] != '\0'; i++){
             if(original[i] == '['){
             quote += 1;
@@ -633,11 +568,9 @@ void op_split(struct ProgramState* state, struct ExceptionHandler* jbuff){
                 if(quote == 0 && round_br == 0 && string == 0){
                     struct StackElem elem;
                     elem.type = Instruction;
-                    elem.val.instr = malloc(i + 2 - start);
-                    if (elem.val.instr == NULL)
+                    elem.code = NULL;
+                    if (!set_Text(&elem, original + start, i + 1 - start))
                         RAISE(jbuff, ProgramPanic);
-                    strncpy(elem.val.instr, original + start, i + 1 - start);
-                    elem.val.instr[i + 1 - start] = '\0';
                     push_Stack(state->stack, elem, jbuff);
                     start = i + 1;
                 }
@@ -648,11 +581,9 @@ void op_split(struct ProgramState* state, struct ExceptionHandler* jbuff){
                 if(quote == 0 && round_br == 0 && string == 0){
                     struct StackElem elem;
                     elem.type = Instruction;
-                    elem.val.instr = malloc(i + 2 - start);
-                    if (elem.val.instr == NULL)
+                    elem.code = NULL;
+                    if (!set_Text(&elem, original + start, i + 1 - start))
                         RAISE(jbuff, ProgramPanic);
-                    strncpy(elem.val.instr, original + start, i + 1 - start);
-                    elem.val.instr[i + 1 - start] = '\0';
                     push_Stack(state->stack, elem, jbuff);
                     start = i + 1;
                 }
@@ -662,11 +593,9 @@ void op_split(struct ProgramState* state, struct ExceptionHandler* jbuff){
                 if(quote == 0 && round_br == 0 && string == 0){
                     struct StackElem elem;
                     elem.type = Instruction;
-                    elem.val.instr = malloc(i + 2 - start);
-                    if (elem.val.instr == NULL)
+                    elem.code = NULL;
+                    if (!set_Text(&elem, original + start, i + 1 - start))
                         RAISE(jbuff, ProgramPanic);
-                    strncpy(elem.val.instr, original + start, i + 1 - start);
-                    elem.val.instr[i + 1 - start] = '\0';
                     push_Stack(state->stack, elem, jbuff);
                     start = i + 1;
                 }
@@ -675,11 +604,9 @@ void op_split(struct ProgramState* state, struct ExceptionHandler* jbuff){
                     if(i - start > 0) {
                         struct StackElem elem;
                         elem.type = Instruction;
-                        elem.val.instr = malloc(i + 1 - start);
-                        if (elem.val.instr == NULL)
+                        elem.code = NULL;
+                        if (!set_Text(&elem, original + start, i - start))
                             RAISE(jbuff, ProgramPanic);
-                        strncpy(elem.val.instr, original + start, i - start);
-                        elem.val.instr[i - start] = '\0';
                         push_Stack(state->stack, elem, jbuff);
                     }
                     start = i + 1;
@@ -689,29 +616,17 @@ void op_split(struct ProgramState* state, struct ExceptionHandler* jbuff){
         if(i) {
             struct StackElem elem;
             elem.type = Instruction;
-            elem.val.instr = malloc(i + 1 - start);
-            if (elem.val.instr == NULL)
+            elem.code = NULL;
+            if (!set_Text(&elem, original + start, i - start))
                 RAISE(jbuff, ProgramPanic);
-            strncpy(elem.val.instr, original + start, i - start);
-            elem.val.instr[i - start] = '\0';
             push_Stack(state->stack, elem, jbuff);
         }
-        free(original);
+        release_Text(&quot);
+        release_Code(origcode);
     }else if(state->stack->content[state->stack->next].type == String){
-        char *original = state->stack->content[state->stack->next].val.instr;
-        char *token = strtok(original, " ");
-        do{
-            struct StackElem elem;
-            elem.type = String;
-            size_t tokenlen = strlen(token);
-            elem.val.instr = malloc(tokenlen + 1);
-             if (elem.val.instr == NULL)
-                RAISE(jbuff, ProgramPanic);
-            memcpy(elem.val.instr, token, tokenlen);
-            elem.val.instr[tokenlen] = '\0';
-            push_Stack(state->stack, elem, jbuff);
-        }while((token = strtok(NULL, " ")) != NULL);
-        free(original);
+        struct StackElem string = state->stack->content[state->stack->next];
+        push_Tokens(state, &string, " ", jbuff);
+        release_Text(&string);
     }else if(state->stack->content[state->stack->next].type == InnerStack){
         struct Stack *src = state->stack->content[state->stack->next].val.stack;
         for(size_t i = 0; i < src->next; i++){
@@ -736,19 +651,18 @@ void brop_compose(struct ProgramState *state, char *comand, size_t clen, struct
     state->stack->next -= 1;
     struct StackElem second = state->stack->content[state->stack->next];
     if(state->stack->content[state->stack->next - 1].type == String && second.type == String && delimiter.type == String){
-        size_t delimlen = strlen(delimiter.val.instr);
-        size_t lensecond = strlen(second.val.instr);
-        size_t lenfirst =  strlen(state->stack->content[state->stack->next - 1].val.instr);
+        size_t delimlen = text_Len(&delimiter);
+        size_t lensecond = text_Len(&second);
+        size_t lenfirst =  text_Len(&state->stack->content[state->stack->next - 1]);
         size_t totsize = lensecond + lenfirst + delimlen + 1;
-        state->stack->content[state->stack->next - 1].val.instr = realloc(state->stack->content[state->stack->next - 1].val.instr, totsize);
-        if(state->stack->content[state->stack->next - 1].val.instr == NULL){
+        char *composte = grow_Text(&state->stack->content[state->stack->next - 1], totsize - 1);
+        if(composte == NULL){
             RAISE(jbuff, ProgramPanic);
         }
-        strcpy(state->stack->content[state->stack->next - 1].val.instr + lenfirst, delimiter.val.instr);
-        strcpy(state->stack->content[state->stack->next - 1].val.instr + delimlen + lenfirst, second.val.instr);
-        state->stack->content[state->stack->next - 1].val.instr[totsize - 1] = '\0';
-        free(delimiter.val.instr);
-        free(second.val.instr);
+        memcpy(composte + lenfirst, text_Elem(&delimiter), delimlen);
+        memcpy(composte + delimlen + lenfirst, text_Elem(&second), lensecond);
+        release_Text(&delimiter);
+        release_Text(&second);
     }else{
         state->stack->next += 2;
         RAISE(jbuff, InvalidOperands);
@@ -783,15 +697,12 @@ void op_pop(struct ProgramState* state, struct ExceptionHandler* jbuff){
     size_t stackindx = state->stack->next - 1;
     if(state->stack->content[stackindx].type != InnerStack)
         RAISE(jbuff, InvalidOperands);
-    struct StackElem res;
     if(state->stack->content[stackindx].val.stack->next == 0){
-        res.type = None;
-        res.val.ival = 0;
+        op_none(state, jbuff);
     }else{
         state->stack->content[stackindx].val.stack->next -= 1;
-        res = state->stack->content[stackindx].val.stack->content[state->stack->content[stackindx].val.stack->next];
+        push_Stack(state->stack, state->stack->content[stackindx].val.stack->content[state->stack->content[stackindx].val.stack->next], jbuff);
     }
-    push_Stack(state->stack, res, jbuff);
 }
 
 void op_inject(struct ProgramState* state, struct ExceptionHandler* jbuff){
@@ -808,12 +719,12 @@ void op_inject(struct ProgramState* state, struct ExceptionHandler* jbuff){
     struct ProgramState stat;
     stat.stack = state->stack->content[stackindx].val.stack;
     stat.env = state->env;
-    char *mem = state->stack->content[state->stack->next].val.instr;
-    add_memory(jbuff, mem);
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    add_code(jbuff, code);
     add_backtrace(jbuff);
-    parse_script(&stat, mem, strlen(mem), jbuff);
+    execute_code(&stat, code, jbuff);
     remove_backtrace(jbuff);
-    remove_memory(jbuff, mem);
+    remove_code(jbuff, code);
 }
 
 void numop_inject(struct ProgramState *state, size_t num, struct ExceptionHandler *jbuff) {
@@ -824,21 +735,23 @@ void numop_inject(struct ProgramState *state, size_t num, struct ExceptionHandle
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
     }
-    char *mem = state->stack->content[state->stack->next].val.instr;
-    add_memory(jbuff, mem);
-    add_backtrace(jbuff);
     for(size_t i = state->stack->next - num; i < state->stack->next; i++){
         if(state->stack->content[i].type != InnerStack){
             state->stack->next += 1;
             RAISE(jbuff, InvalidOperands);
         }
+    }
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    add_code(jbuff, code);
+    add_backtrace(jbuff);
+    for(size_t i = state->stack->next - num; i < state->stack->next; i++){
         struct ProgramState stat;
         stat.stack = state->stack->content[i].val.stack;
         stat.env = state->env;
-        parse_script(&stat, mem, strlen(mem), jbuff);
+        execute_code(&stat, code, jbuff);
     }
     remove_backtrace(jbuff);
-    remove_memory(jbuff, mem);
+    remove_code(jbuff, code);
 }
 
 void numop_pinject(struct ProgramState *state, size_t num, struct ExceptionHandler *jbuff) {
@@ -855,8 +768,8 @@ void numop_pinject(struct ProgramState *state, size_t num, struct ExceptionHandl
             RAISE(jbuff, InvalidOperands);
         }
     }
-    char *mem = state->stack->content[state->stack->next].val.instr;
-    add_memory(jbuff, mem);
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    add_code(jbuff, code);
     add_backtrace(jbuff);
     jbuff->stack_num = num;
     jbuff->inject_err = malloc(sizeof(struct ExceptionHandler *) * num);
@@ -870,7 +783,7 @@ void numop_pinject(struct ProgramState *state, size_t num, struct ExceptionHandl
         if (jbuff->inject_err[i] == NULL)
             exit(-1);
         TRY(jbuff->inject_err[i]) {
-            parse_script(&stat, mem, strlen(mem), jbuff->inject_err[i]);
+            execute_code(&stat, code, jbuff->inject_err[i]);
         }CATCHALL{
             error = 1;
             continue;
@@ -883,7 +796,7 @@ void numop_pinject(struct ProgramState *state, size_t num, struct ExceptionHandl
     free(jbuff->inject_err);
     jbuff->stack_num = 0;
     remove_backtrace(jbuff);
-    remove_memory(jbuff, mem);
+    remove_code(jbuff, code);
 }
 
 void op_compress(struct ProgramState* state, struct ExceptionHandler* jbuff){
@@ -895,7 +808,26 @@ void op_compress(struct ProgramState* state, struct ExceptionHandler* jbuff){
     push_Stack(state->stack, res, jbuff);
 }
 
-void brop_times(struct ProgramState* state, char* number, size_t numberlen, struct ExceptionHandler* jbuff) {
+// bracket instructions whose argument is run after their operands are popped, and by loop at every
+// iteration: the argument is compiled once and the compiled code is run by their codeop
+static inline void call_CodeOp(struct ProgramState *state, code_operations codeop, char *arg, size_t arglen, struct ExceptionHandler *jbuff){
+    struct Code *code = compile_script(arg, arglen, jbuff);
+    add_code(jbuff, code);
+    codeop(state, code, jbuff);
+    remove_code(jbuff, code);
+}
+
+// pushes back the quotation taken to run code, when the operands it comes with turn out to be invalid
+static inline void push_Quotation(struct ProgramState *state, struct Code *code, struct ExceptionHandler *jbuff){
+    struct StackElem quot;
+    quot.type = Instruction;
+    if (!set_Text(&quot, code->src, code->srclen))
+        RAISE(jbuff, ProgramPanic);
+    quot.code = retain_Code(code);
+    push_Stack(state->stack, quot, jbuff);
+}
+
+void codeop_times(struct ProgramState* state, struct Code* number, struct ExceptionHandler* jbuff) {
     if (state->stack->next == 0)
         RAISE(jbuff, StackUnderflow);
     state->stack->next -= 1;
@@ -903,78 +835,139 @@ void brop_times(struct ProgramState* state, char* number, size_t numberlen, stru
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
     }
-    char* mem = state->stack->content[state->stack->next].val.instr;
-    add_memory(jbuff, mem);
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    add_code(jbuff, code);
     add_backtrace(jbuff);
-    parse_script(state, number, numberlen, jbuff);
+    enter_Backtrace(jbuff, number);
+    execute_code(state, number, jbuff);
+    if (state->stack->next == 0) {
+        push_Quotation(state, code, jbuff);
+        RAISE(jbuff, StackUnderflow);
+    }
     state->stack->next -= 1;
     if (state->stack->content[state->stack->next].type != Integer) {
-        state->stack->next += 2;
+        struct StackElem count = state->stack->content[state->stack->next];
+        push_Quotation(state, code, jbuff);
+        push_Stack(state->stack, count, jbuff);
         RAISE(jbuff, InvalidOperands);
     }
+    int64_t times = state->stack->content[state->stack->next].val.ival;
     remove_backtrace(jbuff);
     add_backtrace(jbuff);
-    for (int i = 0; i < state->stack->content[state->stack->next].val.ival; i++) {
-        parse_script(state, mem, strlen(mem), jbuff);
+    for (int64_t i = 0; i < times; i++) {
+        execute_code(state, code, jbuff);
+    }
+    remove_backtrace(jbuff);
+    remove_code(jbuff, code);
+}
+
+void brop_times(struct ProgramState* state, char* number, size_t numberlen, struct ExceptionHandler* jbuff) {
+    call_CodeOp(state, codeop_times, number, numberlen, jbuff);
+}
 
+// times with a constant count, used by the compiler in place of brop_times
+void numop_times(struct ProgramState* state, size_t num, struct ExceptionHandler* jbuff) {
+    if (state->stack->next == 0)
+        RAISE(jbuff, StackUnderflow);
+    state->stack->next -= 1;
+    if (state->stack->content[state->stack->next].type != Instruction) {
+        state->stack->next += 1;
+        RAISE(jbuff, InvalidOperands);
+    }
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    add_code(jbuff, code);
+    add_backtrace(jbuff);
+    for (size_t i = 0; i < num; i++) {
+        execute_code(state, code, jbuff);
     }
     remove_backtrace(jbuff);
-    remove_memory(jbuff, mem);
+    remove_code(jbuff, code);
 }
 
-void brop_load(struct ProgramState *state, char *filename, size_t fnlen, struct ExceptionHandler *jbuff){
-    char *path = malloc(fnlen + 1);
+// copy of the path in the arena of jbuff, it's given back with release_Arena
+static inline char *arena_Path(char *filename, size_t fnlen, struct ExceptionHandler *jbuff){
+    char *path = alloc_Arena(&jbuff->arena, fnlen + 1);
     if(path == NULL)
         RAISE(jbuff, ProgramPanic);
-    strncpy(path, filename, fnlen);
+    memcpy(path, filename, fnlen);
     path[fnlen] = '\0';
+    return path;
+}
+
+void brop_load(struct ProgramState *state, char *filename, size_t fnlen, struct ExceptionHandler *jbuff){
+    struct ArenaMark mark = mark_Arena(&jbuff->arena);
+    char *path = arena_Path(filename, fnlen, jbuff);
     FILE *target = fopen(path, "r");
-    free(path);
+    char *cachepath = target != NULL ? cache_Path(path) : NULL;
+    release_Arena(&jbuff->arena, mark);
     if(target == NULL)
         RAISE(jbuff, FileNotFound);
+    if(cachepath == NULL){
+        fclose(target);
+        RAISE(jbuff, ProgramPanic);
+    }
+    add_memory(jbuff, cachepath, NULL);
     fseek(target, 0, SEEK_END);
     long flen = ftell(target);
-    if(flen < 0){
-        RAISE(jbuff, IOError);
-    }else if(flen == 0){
+    if(flen <= 0){
+        fclose(target);
+        if(flen < 0)
+            RAISE(jbuff, IOError);
+        remove_memory(jbuff, cachepath);
         return;
     }
     char *fcontent = malloc(flen + 1);
-    if (fcontent == NULL)
+    if (fcontent == NULL){
+        fclose(target);
         RAISE(jbuff, ProgramPanic);
+    }
     rewind(target);
     size_t comandlen = fread(fcontent, 1, flen, target);
-    if(comandlen == 0 || fclose(target) != 0)
+    if(fclose(target) != 0 || comandlen == 0){
+        free(fcontent);
         RAISE(jbuff, IOError);
+    }
     fcontent[comandlen] = '\0';
-    add_memory(jbuff, fcontent);
+    uint64_t srchash = source_Hash(fcontent, comandlen);
+    // a valid cache is already compiled, otherwise it's written once the file has run without errors
+    struct Code *code = load_CodeCache(cachepath, srchash, comandlen);
+    int cached = code != NULL;
+    if(!cached){
+        add_memory(jbuff, fcontent, NULL);
+        code = compile_script(fcontent, comandlen, jbuff);
+        remove_memory(jbuff, fcontent);
+    }else{
+        free(fcontent);
+    }
+    add_code(jbuff, code);
     add_backtrace(jbuff);
-    parse_script(state, fcontent, comandlen, jbuff);
+    execute_code(state, code, jbuff);
     remove_backtrace(jbuff);
-    remove_memory(jbuff, fcontent);
+    if(!cached)
+        save_CodeCache(code, cachepath, srchash);
+    remove_memory(jbuff, cachepath);
+    remove_code(jbuff, code);
 }
 
 void brop_save(struct ProgramState *state, char *filename, size_t fnlen, struct ExceptionHandler *jbuff){
-    char *path = malloc(fnlen + 1);
-    if(path == NULL)
-        RAISE(jbuff, ProgramPanic);
-    strncpy(path, filename, fnlen);
-    path[fnlen] = '\0';
+    struct ArenaMark mark = mark_Arena(&jbuff->arena);
+    char *path = arena_Path(filename, fnlen, jbuff);
     FILE *target = fopen(path, "w");
+    release_Arena(&jbuff->arena, mark);
     if(target == NULL)
         RAISE(jbuff, FileNotCreatable);
     for(size_t i = 0; i < state->stack->next; i++){
         switch (state->stack->content[i].type)
         {
         case Instruction:
-            if(fprintf(target, "[%s] ", state->stack->content[i].val.instr) < 0){
+            if(fprintf(target, "[%s] ", text_Elem(&state->stack->content[i])) < 0){
                 fclose(target);
                 RAISE(jbuff, IOError);
             }
             break;
         
         case String:
-            if(fprintf(target, "\"%s\" ", state->stack->content[i].val.instr) < 0){
+            if(fprintf(target, "\"%s\" ", text_Elem(&state->stack->content[i])) < 0){
                 fclose(target);
                 RAISE(jbuff, IOError);
             }
@@ -1031,13 +1024,13 @@ void op_dip(struct ProgramState* state, struct ExceptionHandler* jbuff){
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
     }
-    char* mem = state->stack->content[state->stack->next].val.instr;
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
     state->stack->next -= 1;
     struct StackElem temp = state->stack->content[state->stack->next];
-    add_memory(jbuff, mem);
+    add_code(jbuff, code);
     add_backtrace(jbuff);
-    parse_script(state, mem, strlen(mem), jbuff);
-    remove_memory(jbuff, mem);
+    execute_code(state, code, jbuff);
+    remove_code(jbuff, code);
     remove_backtrace(jbuff);
     push_Stack(state->stack, temp, jbuff);
 }
@@ -1050,41 +1043,43 @@ void op_if(struct ProgramState *state, struct ExceptionHandler *jbuff){
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
     }
-    char *memf = state->stack->content[state->stack->next].val.instr;
+    struct StackElem *quotf = &state->stack->content[state->stack->next];
     state->stack->next -= 1;
     if(state->stack->content[state->stack->next].type != Instruction){
         state->stack->next += 2;
         RAISE(jbuff, InvalidOperands);
     }
-    char *memt = state->stack->content[state->stack->next].val.instr;
+    struct StackElem *quott = &state->stack->content[state->stack->next];
     state->stack->next -= 1;
     if(state->stack->content[state->stack->next].type != Boolean){
         state->stack->next += 3;
         RAISE(jbuff, InvalidOperands);
     }
-    add_memory(jbuff, memt);
-    add_memory(jbuff, memf);
-    add_backtrace(jbuff);
-
+    struct Code *code;
     switch(state->stack->content[state->stack->next].val.ival){
         case 1:
-            parse_script(state, memt, strlen(memt), jbuff);
+            code = take_Quotation(quott, jbuff);
+            release_Text(quotf);
+            release_Code(quotf->code);
         break;
 
         case 0:
-            parse_script(state, memf, strlen(memf), jbuff); 
+            code = take_Quotation(quotf, jbuff);
+            release_Text(quott);
+            release_Code(quott->code);
         break;
 
         default:
         UNREACHABLE;
     }
-
-    remove_memory(jbuff, memf);
-    remove_memory(jbuff, memt);
+    add_code(jbuff, code);
+    add_backtrace(jbuff);
+    execute_code(state, code, jbuff);
+    remove_code(jbuff, code);
     remove_backtrace(jbuff);
 }
 
-void brop_if(struct ProgramState *state, char *cond, size_t condlen, struct ExceptionHandler *jbuff){
+void codeop_if(struct ProgramState *state, struct Code *cond, struct ExceptionHandler *jbuff){
     if(state->stack->next < 2)
         RAISE(jbuff, StackUnderflow);
     state->stack->next -= 1;
@@ -1092,17 +1087,18 @@ void brop_if(struct ProgramState *state, char *cond, size_t condlen, struct Exce
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
     }
-    char *memf = state->stack->content[state->stack->next].val.instr;
     state->stack->next -= 1;
     if(state->stack->content[state->stack->next].type != Instruction){
         state->stack->next += 2;
         RAISE(jbuff, InvalidOperands);
     }
-    char *memt = state->stack->content[state->stack->next].val.instr;
-    add_memory(jbuff, memt);
-    add_memory(jbuff, memf);
+    struct Code *codef = take_Quotation(&state->stack->content[state->stack->next + 1], jbuff);
+    struct Code *codet = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    add_code(jbuff, codet);
+    add_code(jbuff, codef);
     add_backtrace(jbuff);
-    parse_script(state, cond, condlen, jbuff);
+    enter_Backtrace(jbuff, cond);
+    execute_code(state, cond, jbuff);
     if(state->stack->next < 1)
         RAISE(jbuff, StackUnderflow);
     state->stack->next -= 1;
@@ -1112,21 +1108,25 @@ void brop_if(struct ProgramState *state, char *cond, size_t condlen, struct Exce
     }
     switch(state->stack->content[state->stack->next].val.ival){
         case 1:
-            parse_script(state, memt, strlen(memt), jbuff);
+            execute_code(state, codet, jbuff);
         break;
 
         case 0:
-            parse_script(state, memf, strlen(memf), jbuff);
+            execute_code(state, codef, jbuff);
         break;
 
         default:
         UNREACHABLE;
     }
-    remove_memory(jbuff, memt);
-    remove_memory(jbuff, memf);
+    remove_code(jbuff, codet);
+    remove_code(jbuff, codef);
     remove_backtrace(jbuff);
 }
 
+void brop_if(struct ProgramState *state, char *cond, size_t condlen, struct ExceptionHandler *jbuff){
+    call_CodeOp(state, codeop_if, cond, condlen, jbuff);
+}
+
 void op_loop(struct ProgramState *state, struct ExceptionHandler *jbuff){
     if(state->stack->next == 0)
         RAISE(jbuff, StackUnderflow);
@@ -1135,11 +1135,11 @@ void op_loop(struct ProgramState *state, struct ExceptionHandler *jbuff){
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
     }
-    char *mem = state->stack->content[state->stack->next].val.instr;
-    add_memory(jbuff, mem);
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    add_code(jbuff, code);
     add_backtrace(jbuff);
     while (1){
-        parse_script(state, mem, strlen(mem), jbuff);
+        execute_code(state, code, jbuff);
         state->stack->next -= 1;
         if(state->stack->content[state->stack->next].type != Boolean){
             state->stack->next += 1;
@@ -1149,11 +1149,11 @@ void op_loop(struct ProgramState *state, struct ExceptionHandler *jbuff){
             break;
         }
     }
-    remove_memory(jbuff, mem);
+    remove_code(jbuff, code);
     remove_backtrace(jbuff);
 }
 
-void brop_loop(struct ProgramState *state, char *cond, size_t condlen, struct ExceptionHandler *jbuff){
+void codeop_loop(struct ProgramState *state, struct Code *cond, struct ExceptionHandler *jbuff){
     if(state->stack->next == 0)
         RAISE(jbuff, StackUnderflow);
     state->stack->next -= 1;
@@ -1161,11 +1161,12 @@ void brop_loop(struct ProgramState *state, char *cond, size_t condlen, struct Ex
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
     }
-    char *mem = state->stack->content[state->stack->next].val.instr;
-    add_memory(jbuff, mem);
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    add_code(jbuff, code);
     add_backtrace(jbuff);
     while (1){
-        parse_script(state, cond, condlen, jbuff);
+        enter_Backtrace(jbuff, cond);
+        execute_code(state, cond, jbuff);
         state->stack->next -= 1;
         if(state->stack->content[state->stack->next].type != Boolean){
             state->stack->next += 1;
@@ -1174,12 +1175,16 @@ void brop_loop(struct ProgramState *state, char *cond, size_t condlen, struct Ex
         if (state->stack->content[state->stack->next].val.ival == 0) {
             break;
         }
-        parse_script(state, mem, strlen(mem), jbuff);
+        execute_code(state, code, jbuff);
     }
-    remove_memory(jbuff, mem);
+    remove_code(jbuff, code);
     remove_backtrace(jbuff);
 }
 
+void brop_loop(struct ProgramState *state, char *cond, size_t condlen, struct ExceptionHandler *jbuff){
+    call_CodeOp(state, codeop_loop, cond, condlen, jbuff);
+}
+
 void op_try(struct ProgramState *state, struct ExceptionHandler *jbuff){
     if(state->stack->next == 0)
         RAISE(jbuff, StackUnderflow);
@@ -1193,17 +1198,17 @@ void op_try(struct ProgramState *state, struct ExceptionHandler *jbuff){
         state->stack->next += 1;
         RAISE(jbuff, ProgramPanic);
     }
-    char *mem = state->stack->content[state->stack->next].val.instr;
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
     struct StackElem result;
     result.type = Boolean;
     TRY(try_buf){
-        parse_script(state, mem, strlen(mem), try_buf);
+        execute_code(state, code, try_buf);
         result.val.ival = 1;
     }CATCHALL{
         result.val.ival = 0;
     }
-    free(mem);
-    free(try_buf);
+    release_Code(code);
+    free_ExceptionHandler(try_buf);
     push_Stack(state->stack, result, jbuff);
 }
 
@@ -1215,11 +1220,11 @@ void op_apply(struct ProgramState *state, struct ExceptionHandler *jbuff){
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
     }
-    char *mem = state->stack->content[state->stack->next].val.instr;
-    add_memory(jbuff, mem);
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    add_code(jbuff, code);
     add_backtrace(jbuff);
-    parse_script(state, mem, strlen(mem), jbuff);
-    remove_memory(jbuff, mem);
+    execute_code(state, code, jbuff);
+    remove_code(jbuff, code);
     remove_backtrace(jbuff);
 }
 
@@ -1231,20 +1236,17 @@ void brop_dup(struct ProgramState *state, char *comand, size_t clen, struct Exce
     if(state->stack->content[state->stack->next].type == Integer) {
         if (state->stack->content[state->stack->next].val.ival >= state->stack->next)
             RAISE(jbuff, StackUnderflow);
-        struct StackElem copy;
         size_t index = state->stack->next - 1 - state->stack->content[state->stack->next].val.ival;
-        copy.type = state->stack->content[index].type;
+        struct StackElem copy = state->stack->content[index];
         if (copy.type == Instruction || copy.type == String) {
-            size_t srclen = strlen(state->stack->content[index].val.instr) + 1;
-            copy.val.instr = malloc(srclen);
-            memcpy(copy.val.instr, state->stack->content[index].val.instr, srclen);
+            copy_Text(&copy, &state->stack->content[index]);
+            if (copy.type == Instruction)
+                retain_Code(copy.code);
         }else if(copy.type == InnerStack){
             copy.val.stack = malloc(sizeof(struct Stack));
             if(copy.val.stack == NULL)
                 RAISE(jbuff, ProgramPanic);
             copy_Stack(copy.val.stack, state->stack->content[state->stack->next - 1].val.stack, jbuff);
-        }else {
-            copy.val = state->stack->content[index].val;
         }
         push_Stack(state->stack, copy, jbuff);
     }else{
@@ -1275,17 +1277,16 @@ void brop_swap(struct ProgramState *state, char *comand, size_t clen, struct Exc
 }
 
 void brop_dig(struct ProgramState* state, char* number, size_t numberlen, struct ExceptionHandler* jbuff) {
-    add_backtrace(jbuff);
     parse_script(state, number, numberlen, jbuff);
+    if (state->stack->next < 1)
+        RAISE(jbuff, StackUnderflow);
     state->stack->next -= 1;
     if (state->stack->content[state->stack->next].type != Integer) {
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
     }
-    if (state->stack->next <= state->stack->content[state->stack->next].val.ival){
-        state->stack->next += 1;
+    if (state->stack->content[state->stack->next].val.ival >= state->stack->next)
         RAISE(jbuff, StackUnderflow);
-    }
     size_t index = state->stack->next - 1;
     size_t indextar = state->stack->next - 1 - state->stack->content[state->stack->next].val.ival;
     struct StackElem temp = state->stack->content[indextar];
@@ -1293,15 +1294,12 @@ void brop_dig(struct ProgramState* state, char* number, size_t numberlen, struct
         state->stack->content[i] = state->stack->content[i + 1];
     }
     state->stack->content[index] = temp;
-    remove_backtrace(jbuff);
 }
 
 void brop_isdef(struct ProgramState *state, char *funcname, size_t fnlen, struct ExceptionHandler *jbuff){
     struct StackElem elem;
     elem.type = Boolean;
-    char **out = malloc(sizeof(char *));
-    elem.val.ival = get_Environment(state->env, funcname, fnlen, out);
-    free(out);
+    elem.val.ival = find_word(state->env, find_Symbol(funcname, fnlen)) != NULL;
     push_Stack(state->stack, elem, jbuff);
 }
 
@@ -1317,9 +1315,15 @@ void brop_define(struct ProgramState *state, char *funcname, size_t fnlen, struc
         if(RESERVED_CHAR(funcname[i]))
             RAISE(jbuff, InvalidNameDefine);
     }
-    set_Environment(state->env, funcname, fnlen, state->stack->content[state->stack->next].val.instr, jbuff);
+    uint32_t symbol = intern_Symbol(funcname, fnlen);
+    if(symbol == SYMBOL_ERROR)
+        RAISE(jbuff, ProgramPanic);
+    struct Code *code = take_Quotation(&state->stack->content[state->stack->next], jbuff);
+    set_word(state->env, symbol, code, jbuff);
+    atomic_fetch_add_explicit(&definition_generation, 1, memory_order_release);
 }
 
 void brop_delete(struct ProgramState *state, char *funcname, size_t fnlen, struct ExceptionHandler *jbuff){
-    remove_Environment(state->env, funcname, fnlen);
+    remove_Environment(state->env, find_Symbol(funcname, fnlen));
+    atomic_fetch_add_explicit(&definition_generation, 1, memory_order_release);
 }
\ No newline at end of file
@@ -9,38 +9,20 @@
 #include "bool_op.h"
 #include "types_op.h"
 #include "stack_op.h"
+#include "scan.h"
 #include <omp.h>
 
-extern char *INSTRUCTIONS[];
-extern char *BRACKETS_INSTR[];
-
-
-struct OperationElem {
-	char* key;
-	operations op;
-	struct OperationElem* next;
-	size_t key_len;
-};
+#define IS_INDENT(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n' || (c) == '\0')
 
-struct BrOperationElem {
-	char* key;
-	br_operations brop;
-	struct BrOperationElem* next;
-	size_t key_len;
-};
+#define RESERVED_CHAR(c) (IS_INDENT(c) || (c) == '[' || (c) == ']' || (c) == '{' || (c) == '}' || (c) == '(' || (c) == ')' || (c) == '"')
 
-struct NumOperationElem {
-	char* key;
-	num_operations numop;
-	struct NumOperationElem* next;
-	size_t key_len;
-};
+extern char *INSTRUCTIONS[];
+extern char *BRACKETS_INSTR[];
+extern char *NUMBERED_INSTR[];
+extern const operations INSTR_OP[];
+extern const br_operations BR_INSTR_OP[];
+extern const num_operations NUM_INSTR_OP[];
 
-struct Builtins {
-	struct OperationElem** op_map;
-	struct BrOperationElem** brop_map;
-	struct NumOperationElem** numop_map;
-};
 
 enum TokenType{
     InstrToken,
@@ -50,7 +32,8 @@ enum TokenType{
     GenericToken,
 	NumInsrtToken,
 	IntegerToken,
-	DecimalToken
+	DecimalToken,
+	ErrorToken
 };
 
 struct _special_instr{
@@ -72,9 +55,12 @@ struct Token{
 	union TokenInfo info;
 };
 
-extern struct Builtins builtins;
-int init_builtins();
-void free_builtins();
+extern atomic_size_t definition_generation;
+operations find_op(const char *key, size_t keylen);
+br_operations find_brop(const char *key, size_t keylen);
+num_operations find_numop(const char *key, size_t keylen);
+struct Code *find_word(struct Environment *env, uint32_t symbol);
+void set_word(struct Environment *env, uint32_t symbol, struct Code *code, struct ExceptionHandler *jbuff);
 
 void op_stack(struct ProgramState *state, struct ExceptionHandler *jbuff);
 
@@ -107,6 +93,10 @@ void brop_dup(struct ProgramState *state, char *comand, size_t clen, struct Exce
 void brop_if(struct ProgramState *state, char *cond, size_t condlen, struct ExceptionHandler *jbuff);
 void brop_loop(struct ProgramState *state, char *cond, size_t condlen, struct ExceptionHandler *jbuff);
 void brop_times(struct ProgramState* state, char* number, size_t numberlen, struct ExceptionHandler* jbuff);
+void numop_times(struct ProgramState* state, size_t num, struct ExceptionHandler* jbuff);
+void codeop_if(struct ProgramState *state, struct Code *cond, struct ExceptionHandler *jbuff);
+void codeop_loop(struct ProgramState *state, struct Code *cond, struct ExceptionHandler *jbuff);
+void codeop_times(struct ProgramState* state, struct Code* number, struct ExceptionHandler* jbuff);
 
 void brop_split(struct ProgramState *state, char *comand, size_t clen, struct ExceptionHandler *jbuff);
 void brop_compose(struct ProgramState *state, char *comand, size_t clen, struct ExceptionHandler *jbuff);
@@ -117,6 +107,8 @@ void brop_delete(struct ProgramState *state, char *funcname, size_t fnlen, struc
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+int next_token(char *comands, size_t clen, size_t *pos, struct Token *token, const struct SourceIndex *index, struct ExceptionHandler *jbuff);
+void execute_word(struct ProgramState *state, char *name, size_t namelen, struct ExceptionHandler *jbuff);
 void execute_instr(struct ProgramState *state, struct Token *token, struct ExceptionHandler *jbuff);
 void parse_script(struct ProgramState *state, char *comands, size_t clen, struct ExceptionHandler *jbuff);
 void execute(struct ProgramState *state, char *comands, struct ExceptionHandler *jbuff);
@@ -0,0 +1,471 @@
+#define _DEFAULT_SOURCE
+#include "jit.h"
+#include "aot.h"
+
+int jit_enabled = 1;
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stddef.h>
+
+// Template JIT: every instruction of the code becomes a fixed sequence of x86-64 instructions.
+// Pushes of constants and + - * / on integers and floats are done inline on the stack content,
+// builtins are called directly and everything else goes through jit_Instr. The code is translated
+// up to its first call, which the VM runs on a frame of jbuff like the rest of the code: the machine
+// code never nests a call on the C stack, and tail calls are still run in place.
+//
+// The generated function keeps state in rbx and jbuff in r12; rdx holds state->stack and rax points
+// to the element at stack->next while an inline instruction is running.
+
+#define ELEM_SIZE ((int) sizeof(struct StackElem))
+#define ELEM_TYPE(n) ((unsigned char)((int) offsetof(struct StackElem, type) - (n) * ELEM_SIZE))
+#define ELEM_VAL(n) ((unsigned char)((int) offsetof(struct StackElem, val) - (n) * ELEM_SIZE))
+#define STATE_STACK ((unsigned char) offsetof(struct ProgramState, stack))
+#define STACK_CONTENT ((unsigned char) offsetof(struct Stack, content))
+#define STACK_CAPACITY ((unsigned char) offsetof(struct Stack, capacity))
+#define STACK_NEXT ((unsigned char) offsetof(struct Stack, next))
+
+_Static_assert(sizeof(struct StackElem) * 2 < 128 && offsetof(struct StackElem, val) < 128, "stack elements must be addressable with 8 bit displacements");
+_Static_assert(sizeof(struct ProgramState) < 128 && sizeof(struct Stack) < 128, "state fields must be addressable with 8 bit displacements");
+_Static_assert(sizeof(enum ElemType) == 4, "element types are compared as 32 bit values");
+
+struct JitBuf{
+    unsigned char *bytes;
+    size_t size;
+    size_t capacity;
+    int failed;
+};
+
+static void emit_Bytes(struct JitBuf *buf, const unsigned char *bytes, size_t len){
+    if(buf->failed)
+        return;
+    if(buf->size + len > buf->capacity){
+        unsigned char *newmem = realloc(buf->bytes, buf->capacity * 2 + len);
+        if(newmem == NULL){
+            buf->failed = 1;
+            return;
+        }
+        buf->bytes = newmem;
+        buf->capacity = buf->capacity * 2 + len;
+    }
+    memcpy(buf->bytes + buf->size, bytes, len);
+    buf->size += len;
+}
+
+#define EMIT(buf, ...) emit_Bytes(buf, (const unsigned char[]){__VA_ARGS__}, sizeof((const unsigned char[]){__VA_ARGS__}))
+
+static void emit_U32(struct JitBuf *buf, uint32_t val){
+    unsigned char bytes[4];
+    for(size_t i = 0; i < 4; i++)
+        bytes[i] = (unsigned char)(val >> (8 * i));
+    emit_Bytes(buf, bytes, 4);
+}
+
+static void emit_U64(struct JitBuf *buf, uint64_t val){
+    emit_U32(buf, (uint32_t) val);
+    emit_U32(buf, (uint32_t)(val >> 32));
+}
+
+// emits a jump with a rel32 to fill with patch_Jump, returns where the rel32 is
+static size_t emit_Jump(struct JitBuf *buf, unsigned char cond){
+    if(cond == 0)
+        EMIT(buf, 0xE9);
+    else
+        EMIT(buf, 0x0F, cond);
+    emit_U32(buf, 0);
+    return buf->size - 4;
+}
+
+#define JMP 0x00
+#define JB 0x82
+#define JE 0x84
+#define JNE 0x85
+
+static void patch_Jump(struct JitBuf *buf, size_t at){
+    if(buf->failed)
+        return;
+    uint32_t rel = (uint32_t)(buf->size - (at + 4));
+    for(size_t i = 0; i < 4; i++)
+        buf->bytes[at + i] = (unsigned char)(rel >> (8 * i));
+}
+
+// jbuff->not_exec[jbuff->bt_size - 1] = token
+static void emit_NotExec(struct JitBuf *buf, char *token){
+    EMIT(buf, 0x49, 0x8B, 0x84, 0x24);
+    emit_U32(buf, (uint32_t) offsetof(struct ExceptionHandler, not_exec));
+    EMIT(buf, 0x49, 0x8B, 0x8C, 0x24);
+    emit_U32(buf, (uint32_t) offsetof(struct ExceptionHandler, bt_size));
+    EMIT(buf, 0x48, 0xBA);
+    emit_U64(buf, (uint64_t)(uintptr_t) token);
+    EMIT(buf, 0x48, 0x89, 0x54, 0xC8, 0xF8);
+}
+
+// fn(state, jbuff), or fn(state, jbuff, instr) when instr is not NULL
+static void emit_Call(struct JitBuf *buf, uintptr_t fn, struct Instr *instr){
+    EMIT(buf, 0x48, 0x89, 0xDF, 0x4C, 0x89, 0xE6);
+    if(instr != NULL){
+        EMIT(buf, 0x48, 0xBA);
+        emit_U64(buf, (uint64_t)(uintptr_t) instr);
+    }
+    EMIT(buf, 0x48, 0xB8);
+    emit_U64(buf, (uint64_t) fn);
+    EMIT(buf, 0xFF, 0xD0);
+}
+
+// rdx = state->stack, rax = &stack->content[stack->next], jumps to the returned rel32 if there are less than n elements
+static size_t emit_LoadStack(struct JitBuf *buf, unsigned char n){
+    EMIT(buf, 0x48, 0x8B, 0x53, STATE_STACK, 0x48, 0x8B, 0x4A, STACK_NEXT);
+    EMIT(buf, 0x48, 0x83, 0xF9, n);
+    size_t underflow = emit_Jump(buf, JB);
+    EMIT(buf, 0x48, 0x8B, 0x42, STACK_CONTENT, 0x48, 0x69, 0xC9);
+    emit_U32(buf, (uint32_t) ELEM_SIZE);
+    EMIT(buf, 0x48, 0x01, 0xC8);
+    return underflow;
+}
+
+// cmp dword [rax + type of TOS(n)], type; jne
+static size_t emit_CheckType(struct JitBuf *buf, int n, enum ElemType type){
+    EMIT(buf, 0x83, 0x78, ELEM_TYPE(n), (unsigned char) type);
+    return emit_Jump(buf, JNE);
+}
+
+static void jit_Instr(struct ProgramState *state, struct ExceptionHandler *jbuff, struct Instr *instr){
+    jbuff->not_exec[jbuff->bt_size - 1] = instr->token.instr;
+    struct StackElem elem;
+    struct ProgramState sstat;
+    switch(generic_OpCode(instr_OpCode(instr))){
+        case PushInt:
+            aot_push_int(state, instr->token.info.integer, jbuff);
+            break;
+        case PushFloat:
+            aot_push_float(state, instr->token.info.decimal, jbuff);
+            break;
+        case PushBool:
+            aot_push_bool(state, instr->token.info.integer, jbuff);
+            break;
+        case PushString:
+            aot_push_text(state, String, instr->token.instr, instr->token.info.stringlen, NULL, jbuff);
+            break;
+        case PushQuote:
+            aot_push_text(state, Instruction, instr->token.instr, instr->token.info.stringlen, instr->quote, jbuff);
+            break;
+        case PushStack:
+            elem = new_Stack(jbuff);
+            sstat.stack = elem.val.stack;
+            sstat.env = state->env;
+            add_backtrace(jbuff);
+            execute_code(&sstat, instr->quote, jbuff);
+            remove_backtrace(jbuff);
+            push_Stack(state->stack, elem, jbuff);
+            break;
+        case CallOp: case OpNot: case OpDup: case OpSwap: case OpDrop: case OpNop:
+            instr->arg.op(state, jbuff);
+            break;
+        case CallBrOp:
+            instr->arg.brop(state, instr->token.instr + instr->token.info.special.val + 1, instr->token.info.special.instrlen, jbuff);
+            break;
+        case CallBrCode:
+            execute_code(state, instr->quote, jbuff);
+            jbuff->not_exec[jbuff->bt_size - 1] = instr->token.instr;
+            instr->arg.brop(state, instr->token.instr + instr->token.info.special.val + 1, 0, jbuff);
+            break;
+        case CallBrNumOp:
+            if(instr->arg.brnum.brop == NULL || instr->arg.brnum.num < state->stack->next)
+                instr->arg.brnum.numop(state, instr->arg.brnum.num, jbuff);
+            else
+                instr->arg.brnum.brop(state, instr->token.instr + instr->token.info.special.val + 1, instr->token.info.special.instrlen, jbuff);
+            break;
+        case CallCodeOp:
+            instr->arg.brcode.codeop(state, instr->quote, jbuff);
+            break;
+        case CallNumOp:
+            instr->arg.numop(state, instr->token.info.special.val, jbuff);
+            break;
+        case RaiseError:
+            RAISE(jbuff, instr->token.info.integer);
+        case OpSum:
+            aot_sum(state, jbuff);
+            break;
+        case OpSub:
+            aot_sub(state, jbuff);
+            break;
+        case OpMul:
+            aot_mul(state, jbuff);
+            break;
+        case OpLower:
+            aot_lower(state, jbuff);
+            break;
+        case OpGreather:
+            aot_greather(state, jbuff);
+            break;
+        case OpLowerEq:
+            aot_lowereq(state, jbuff);
+            break;
+        case OpGreatherEq:
+            aot_greathereq(state, jbuff);
+            break;
+        case OpEqual:
+            aot_equal(state, jbuff);
+            break;
+        case OpNotEqual:
+            aot_notequal(state, jbuff);
+            break;
+        case OpAnd:
+            aot_and(state, jbuff);
+            break;
+        case OpOr:
+            aot_or(state, jbuff);
+            break;
+        case OpSizeGreatherImm:
+            aot_push_bool(state, (int64_t)state->stack->next > instr->arg.fused.imm, jbuff);
+            break;
+        case OpSquare:
+            op_dup(state, jbuff);
+            jbuff->not_exec[jbuff->bt_size - 1] = instr->arg.fused.lasttoken;
+            aot_mul(state, jbuff);
+            break;
+        case OpSwapSub:
+            op_swap(state, jbuff);
+            jbuff->not_exec[jbuff->bt_size - 1] = instr->arg.fused.lasttoken;
+            aot_sub(state, jbuff);
+            break;
+        case OpDupNMulImm:
+            numop_dup(state, instr->arg.fused.num, jbuff);
+            jbuff->not_exec[jbuff->bt_size - 1] = instr->arg.fused.lasttoken;
+            aot_mul_imm(state, instr->arg.fused.imm, jbuff);
+            break;
+        default:
+            jbuff->not_exec[jbuff->bt_size - 1] = instr->arg.fused.lasttoken;
+            switch(generic_OpCode(instr_OpCode(instr))){
+                case OpSumImm:
+                    aot_sum_imm(state, instr->arg.fused.imm, jbuff);
+                    break;
+                case OpSubImm:
+                    aot_sub_imm(state, instr->arg.fused.imm, jbuff);
+                    break;
+                case OpMulImm:
+                    aot_mul_imm(state, instr->arg.fused.imm, jbuff);
+                    break;
+                case OpLowerImm:
+                    aot_lower_imm(state, instr->arg.fused.imm, jbuff);
+                    break;
+                case OpGreatherImm:
+                    aot_greather_imm(state, instr->arg.fused.imm, jbuff);
+                    break;
+                case OpLowerEqImm:
+                    aot_lowereq_imm(state, instr->arg.fused.imm, jbuff);
+                    break;
+                case OpGreatherEqImm:
+                    aot_greathereq_imm(state, instr->arg.fused.imm, jbuff);
+                    break;
+                case OpEqualImm:
+                    aot_equal_imm(state, instr->arg.fused.imm, jbuff);
+                    break;
+                case OpNotEqualImm:
+                    aot_notequal_imm(state, instr->arg.fused.imm, jbuff);
+                    break;
+                default:
+                    UNREACHABLE;
+            }
+    }
+}
+
+// the last two bytes of the SSE2 arithmetic instructions and the integer ones working on [rax + disp8]
+enum JitArith{ JitAdd, JitSub, JitMul, JitDiv };
+
+static void emit_Push(struct JitBuf *buf, struct Instr *instr, enum ElemType type){
+    EMIT(buf, 0x48, 0x8B, 0x53, STATE_STACK, 0x48, 0x8B, 0x4A, STACK_NEXT);
+    EMIT(buf, 0x48, 0x8D, 0x41, 0x01, 0x48, 0x3B, 0x42, STACK_CAPACITY);
+    size_t full = emit_Jump(buf, JE);
+    EMIT(buf, 0x48, 0x8B, 0x42, STACK_CONTENT, 0x48, 0x69, 0xC9);
+    emit_U32(buf, (uint32_t) ELEM_SIZE);
+    EMIT(buf, 0x48, 0x01, 0xC8);
+    EMIT(buf, 0xC7, 0x40, ELEM_TYPE(0));
+    emit_U32(buf, (uint32_t) type);
+    EMIT(buf, 0x48, 0xBE);
+    emit_U64(buf, (uint64_t) instr->token.info.integer);
+    EMIT(buf, 0x48, 0x89, 0x70, ELEM_VAL(0), 0x48, 0xFF, 0x42, STACK_NEXT);
+    size_t done = emit_Jump(buf, JMP);
+    patch_Jump(buf, full);
+    emit_Call(buf, (uintptr_t) jit_Instr, instr);
+    patch_Jump(buf, done);
+}
+
+static void emit_Binary(struct JitBuf *buf, struct Instr *instr, enum JitArith arith){
+    static const unsigned char SSE_OP[] = {[JitAdd] = 0x58, [JitSub] = 0x5C, [JitMul] = 0x59, [JitDiv] = 0x5E};
+    size_t slow[7];
+    size_t nslow = 0;
+    slow[nslow++] = emit_LoadStack(buf, 2);
+    size_t floating = emit_CheckType(buf, 1, Integer);
+    slow[nslow++] = emit_CheckType(buf, 2, Integer);
+    switch(arith){
+        case JitAdd:
+            EMIT(buf, 0x48, 0x8B, 0x70, ELEM_VAL(1), 0x48, 0x01, 0x70, ELEM_VAL(2));
+            break;
+        case JitSub:
+            EMIT(buf, 0x48, 0x8B, 0x70, ELEM_VAL(1), 0x48, 0x29, 0x70, ELEM_VAL(2));
+            break;
+        case JitMul:
+            EMIT(buf, 0x48, 0x8B, 0x48, ELEM_VAL(2), 0x48, 0x0F, 0xAF, 0x48, ELEM_VAL(1), 0x48, 0x89, 0x48, ELEM_VAL(2));
+            break;
+        case JitDiv:
+            // integers are divided as floats, the division by zero is raised by op_div
+            EMIT(buf, 0x48, 0x83, 0x78, ELEM_VAL(1), 0x00);
+            slow[nslow++] = emit_Jump(buf, JE);
+            EMIT(buf, 0xF2, 0x48, 0x0F, 0x2A, 0x40, ELEM_VAL(2), 0xF2, 0x48, 0x0F, 0x2A, 0x48, ELEM_VAL(1));
+            EMIT(buf, 0xF2, 0x0F, 0x5E, 0xC1, 0xF2, 0x0F, 0x11, 0x40, ELEM_VAL(2));
+            EMIT(buf, 0xC7, 0x40, ELEM_TYPE(2));
+            emit_U32(buf, (uint32_t) Floating);
+            break;
+    }
+    size_t pop = emit_Jump(buf, JMP);
+    patch_Jump(buf, floating);
+    slow[nslow++] = emit_CheckType(buf, 1, Floating);
+    slow[nslow++] = emit_CheckType(buf, 2, Floating);
+    if(arith == JitDiv){
+        EMIT(buf, 0x66, 0x0F, 0x57, 0xC9, 0x66, 0x0F, 0x2E, 0x48, ELEM_VAL(1));
+        slow[nslow++] = emit_Jump(buf, JE);
+    }
+    EMIT(buf, 0xF2, 0x0F, 0x10, 0x40, ELEM_VAL(2), 0xF2, 0x0F, SSE_OP[arith], 0x40, ELEM_VAL(1), 0xF2, 0x0F, 0x11, 0x40, ELEM_VAL(2));
+    patch_Jump(buf, pop);
+    EMIT(buf, 0x48, 0xFF, 0x4A, STACK_NEXT);
+    size_t done = emit_Jump(buf, JMP);
+    for(size_t i = 0; i < nslow; i++)
+        patch_Jump(buf, slow[i]);
+    emit_Call(buf, (uintptr_t) jit_Instr, instr);
+    patch_Jump(buf, done);
+}
+
+static void emit_Immediate(struct JitBuf *buf, struct Instr *instr, enum JitArith arith){
+    uint32_t imm = (uint32_t) instr->arg.fused.imm;
+    size_t underflow = emit_LoadStack(buf, 1);
+    size_t notint = emit_CheckType(buf, 1, Integer);
+    switch(arith){
+        case JitAdd:
+            EMIT(buf, 0x48, 0x81, 0x40, ELEM_VAL(1));
+            emit_U32(buf, imm);
+            break;
+        case JitSub:
+            EMIT(buf, 0x48, 0x81, 0x68, ELEM_VAL(1));
+            emit_U32(buf, imm);
+            break;
+        case JitMul:
+            EMIT(buf, 0x48, 0x69, 0x48, ELEM_VAL(1));
+            emit_U32(buf, imm);
+            EMIT(buf, 0x48, 0x89, 0x48, ELEM_VAL(1));
+            break;
+        default:
+            UNREACHABLE;
+    }
+    size_t done = emit_Jump(buf, JMP);
+    patch_Jump(buf, underflow);
+    patch_Jump(buf, notint);
+    emit_Call(buf, (uintptr_t) jit_Instr, instr);
+    patch_Jump(buf, done);
+}
+
+#define FITS_32(imm) ((imm) >= INT32_MIN && (imm) <= INT32_MAX)
+
+// the unchecked and quickened opcodes are translated as their generic ones, the guards are cheap next to the call of jit_Instr
+static void template_Instr(struct JitBuf *buf, struct Instr *instr){
+    switch(generic_OpCode(instr_OpCode(instr))){
+        case PushInt:
+            emit_Push(buf, instr, Integer);
+            break;
+        case PushBool:
+            emit_Push(buf, instr, Boolean);
+            break;
+        case OpSum:
+            emit_Binary(buf, instr, JitAdd);
+            break;
+        case OpSub:
+            emit_Binary(buf, instr, JitSub);
+            break;
+        case OpMul:
+            emit_Binary(buf, instr, JitMul);
+            break;
+        case OpSumImm:
+            if(FITS_32(instr->arg.fused.imm))
+                emit_Immediate(buf, instr, JitAdd);
+            else
+                emit_Call(buf, (uintptr_t) jit_Instr, instr);
+            break;
+        case OpSubImm:
+            if(FITS_32(instr->arg.fused.imm))
+                emit_Immediate(buf, instr, JitSub);
+            else
+                emit_Call(buf, (uintptr_t) jit_Instr, instr);
+            break;
+        case OpMulImm:
+            if(FITS_32(instr->arg.fused.imm))
+                emit_Immediate(buf, instr, JitMul);
+            else
+                emit_Call(buf, (uintptr_t) jit_Instr, instr);
+            break;
+        case CallOp: case OpNot: case OpDup: case OpSwap: case OpDrop:
+            if(instr->arg.op == op_div){
+                emit_Binary(buf, instr, JitDiv);
+            }else{
+                emit_NotExec(buf, instr->token.instr);
+                emit_Call(buf, (uintptr_t) instr->arg.op, NULL);
+            }
+            break;
+        case OpNop: case End:
+            break;
+        default:
+            emit_Call(buf, (uintptr_t) jit_Instr, instr);
+    }
+}
+
+void jit_Code(struct Code *code){
+    size_t len = 0;
+    while(len < code->size && !is_Call(instr_OpCode(&code->instrs[len])))
+        len += 1;
+    if(len < 2)
+        return;
+    struct JitBuf buf = {malloc(256), 0, 256, 0};
+    if(buf.bytes == NULL)
+        return;
+    buf.failed = 0;
+    // push rbx; push r12; push r13; mov rbx, rdi; mov r12, rsi
+    EMIT(&buf, 0x53, 0x41, 0x54, 0x41, 0x55, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4);
+    for(size_t i = 0; i < len; i++)
+        template_Instr(&buf, &code->instrs[i]);
+    // pop r13; pop r12; pop rbx; ret
+    EMIT(&buf, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3);
+    if(!buf.failed){
+        long page = sysconf(_SC_PAGESIZE);
+        size_t size = (buf.size + page - 1) / page * page;
+        void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mem != MAP_FAILED){
+            memcpy(mem, buf.bytes, buf.size);
+            if(mprotect(mem, size, PROT_READ | PROT_EXEC) == 0){
+                code->jitsize = size;
+                code->jitlen = len;
+                atomic_store_explicit(&code->jit, (operations)(uintptr_t) mem, memory_order_release);
+            }else{
+                munmap(mem, size);
+            }
+        }
+    }
+    free(buf.bytes);
+}
+
+void free_Jit(struct Code *code){
+    operations jit = atomic_load_explicit(&code->jit, memory_order_relaxed);
+    if(jit != NULL)
+        munmap((void *)(uintptr_t) jit, code->jitsize);
+}
+
+#else
+
+void jit_Code(struct Code *code){
+    (void) code;
+}
+
+void free_Jit(struct Code *code){
+    (void) code;
+}
+
+#endif
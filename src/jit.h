@@ -0,0 +1,13 @@
+#ifndef SSCRIPT_JIT_H
+#define SSCRIPT_JIT_H
+#include "compiler.h"
+
+// a code is translated to machine code after it's been entered JIT_THRESHOLD times
+#define JIT_THRESHOLD 64
+
+extern int jit_enabled;
+
+void jit_Code(struct Code *code);
+void free_Jit(struct Code *code);
+
+#endif
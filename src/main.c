@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <string.h>
 #include "interpreter.h"
+#include "aot.h"
+#include "jit.h"
+#include "image.h"
 #include "memdebug.h"
 #define BUFFERSIZE 256
 
@@ -8,6 +11,9 @@
 
 void print_usage() {
     printf("\nUsage:\n\tsscript [-options] [File to load before the shell starts]\n" \
+        "\tsscript --emit-c <File> > <File>.c\ttranslate the file to C, see make examples\n" \
+        "\tsscript [-options] [File] --dump-image <Image>\tsave the definitions and the stack to Image instead of starting the shell\n" \
+        "\tsscript --image <Image> [-options] [File]\tstart from the state saved in Image\n" \
         "\targs are optionals:\n\n" \
         "doucumentation available at https://p4o1o.github.io/stack_script/\n\n" \
         "options must be in this format: -v, -sv2m -sv, ... (the order doesen't matter)\n" \
@@ -17,10 +23,28 @@ void print_usage() {
         "\t-h\t\t print this message.\n" \
         "\t-m\t\t load the math library before the shell starts\n" \
         "\t-m\t\t load the probability library before the shell starts\n" \
-        "\t-s\t\t load the stack operations library before the shell starts\n\n"
+        "\t-s\t\t load the stack operations library before the shell starts\n"
+        "\t-f\t\t print the superinstructions fused by the compiler when the shell exits\n"
+        "\t-J\t\t don't translate the hot code to machine code\n\n"
     );
 }
 
+void load_image(struct ProgramState* state, char* imagepath) {
+    struct ExceptionHandler* try_buf = init_ExceptionHandler();
+    if (try_buf == NULL)
+        exit(-1);
+    try_buf->not_exec[0] = imagepath;
+    TRY(try_buf) {
+        load_Image(state, imagepath, try_buf);
+        free_ExceptionHandler(try_buf);
+    }CATCHALL{
+        print_Exception(try_buf);
+        free_ExceptionHandler(try_buf);
+        free_PrgState(state);
+        exit(-1);
+    }
+}
+
 void load_file(struct ProgramState* state, char* filepath) {
     struct ExceptionHandler* try_buf = init_ExceptionHandler();
     if (try_buf == NULL)
@@ -39,14 +63,38 @@ void load_file(struct ProgramState* state, char* filepath) {
 
 
 int main(int argc, char *argv[]) {
-    if (!init_builtins())
-        exit(-1);
     struct ProgramState state = init_PrgState(256, 256);
     struct ExceptionHandler* try_buf = init_ExceptionHandler();
     if (try_buf == NULL)
         return -1;
     size_t size = 0;
+    int fusions = 0;
+    char *dumpimage = NULL;
+    for (int i = 1; i + 1 < argc; i++) {
+        int image = strcmp(argv[i], "--image") == 0;
+        if (image || strcmp(argv[i], "--dump-image") == 0) {
+            if (image)
+                load_image(&state, argv[i + 1]);
+            else
+                dumpimage = argv[i + 1];
+            for (int j = i; j + 2 <= argc; j++)
+                argv[j] = argv[j + 2];
+            argc -= 2;
+            i -= 1;
+        }
+    }
     if (argc > 1) {
+        if (strcmp(argv[1], "--emit-c") == 0) {
+            free_ExceptionHandler(try_buf);
+            free_PrgState(&state);
+            if (argc != 3) {
+                print_usage();
+                return 1;
+            }
+            int res = emit_C(stdout, argv[2]);
+            free_Symbols();
+            return res;
+        }
         if (argv[1][0] == '-') {
             size_t i = 1;
             while (argv[1][i] != '\0') {
@@ -74,6 +122,12 @@ int main(int argc, char *argv[]) {
                 else if (argv[1][i] == 's') {
                     load_file(&state, "stackop.sksp");
                 }
+                else if (argv[1][i] == 'f') {
+                    fusions = 1;
+                }
+                else if (argv[1][i] == 'J') {
+                    jit_enabled = 0;
+                }
                 else if (argv[1][i] == 'p') {
                     load_file(&state, "probability.sksp");
                 }
@@ -95,28 +149,44 @@ int main(int argc, char *argv[]) {
             load_file(&state, argv[1]);
         }
     }
+    if (dumpimage != NULL) {
+        TRY(try_buf) {
+            dump_Image(&state, dumpimage, try_buf);
+        }CATCHALL{
+            print_Exception(try_buf);
+        }
+        int res = try_buf->exit_value == ProgramOk ? 0 : -1;
+        free_ExceptionHandler(try_buf);
+        free_PrgState(&state);
+        free_Symbols();
+        print_allocated_mem();
+        return res;
+    }
     printf("STACK_SCRIPT\n-------------------------------------------\n");
     char bufferin[BUFFERSIZE];
     while(1){
         printf(">");
         fflush(stdout);
         TRY(try_buf) {
-            if (fgets(bufferin, BUFFERSIZE, stdin) != NULL) {
-                execute(&state, bufferin, try_buf);
+            if (fgets(bufferin, BUFFERSIZE, stdin) == NULL) {
+                break;
             }
+            execute(&state, bufferin, try_buf);
             size_t elem_to_print = MIN(size, state.stack->next);
             print_stack(&state, elem_to_print);
-            continue;
         }CATCH(try_buf, ProgramExit) {
             break;
         }CATCHALL{
             print_Exception(try_buf);
         }
+        // resets the arena of the line too, whether it raised or not
         reload_Exceptionhandler(try_buf);
     }
     free_ExceptionHandler(try_buf);
     free_PrgState(&state);
-    free_builtins();
+    free_Symbols();
+    if (fusions)
+        print_fusions();
     print_allocated_mem();
     return 0;
 }
@@ -1,5 +1,7 @@
 #include "memdebug.h"
 
+#ifdef SSCRIPT_MEMDEBUG
+
 #undef malloc
 #undef calloc
 #undef realloc
@@ -7,10 +9,69 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// The blocks are tracked in a hash table of the addresses split in shards, each with its own lock,
+// so that the threads of numop_pinject can allocate together and every operation takes O(1)
+#define SHARD_BITS 6
+#define SHARDS (1 << SHARD_BITS)
+#define MIN_BUCKETS 64
+
+struct memshard {
+	atomic_int lock;
+	struct memblock** buckets;
+	size_t capacity;
+	size_t size;
+};
+
+static struct memshard shards[SHARDS];
+
+static inline uint64_t hash_addr(void* addr) {
+	return ((uint64_t)(uintptr_t)addr >> 4) * 0x9E3779B97F4A7C15u;
+}
+
+static inline struct memshard* shard_of(uint64_t hash) {
+	return &shards[hash >> (64 - SHARD_BITS)];
+}
 
-struct memblock* allocated_mem = NULL;
+static inline struct memblock** bucket_of(struct memshard* shard, uint64_t hash) {
+	return &shard->buckets[(hash >> 16) & (shard->capacity - 1)];
+}
+
+static inline void lock_shard(struct memshard* shard) {
+	while (atomic_exchange_explicit(&shard->lock, 1, memory_order_acquire))
+		;
+}
+
+static inline void unlock_shard(struct memshard* shard) {
+	atomic_store_explicit(&shard->lock, 0, memory_order_release);
+}
+
+// when the buckets can't be doubled the chains just get longer
+static void grow_shard(struct memshard* shard) {
+	size_t capacity = shard->capacity == 0 ? MIN_BUCKETS : shard->capacity * 2;
+	struct memblock** buckets = calloc(capacity, sizeof(struct memblock*));
+	if (buckets == NULL)
+		return;
+	struct memblock** old = shard->buckets;
+	size_t oldcap = shard->capacity;
+	shard->buckets = buckets;
+	shard->capacity = capacity;
+	for (size_t i = 0; i < oldcap; i++) {
+		while (old[i] != NULL) {
+			struct memblock* block = old[i];
+			old[i] = block->next;
+			struct memblock** bucket = bucket_of(shard, hash_addr(block->addr));
+			block->next = *bucket;
+			*bucket = block;
+		}
+	}
+	if (old != NULL)
+		free(old);
+}
 
-inline int new_memblock(void *addr, size_t size, char* file, int line){
+static int new_memblock(void *addr, size_t size, char* file, size_t line) {
 	struct memblock *res = (struct memblock*) malloc(sizeof(struct memblock));
 	if (res == NULL)
 		return 0;
@@ -18,23 +79,46 @@ inline int new_memblock(void *addr, size_t size, char* file, int line){
 	res->size = size;
 	res->file = file;
 	res->line = line;
-	res->next = allocated_mem;
-	allocated_mem = res;
+	uint64_t hash = hash_addr(addr);
+	struct memshard* shard = shard_of(hash);
+	lock_shard(shard);
+	if (shard->size >= shard->capacity)
+		grow_shard(shard);
+	if (shard->capacity == 0) {
+		unlock_shard(shard);
+		free(res);
+		return 0;
+	}
+	struct memblock** bucket = bucket_of(shard, hash);
+	res->next = *bucket;
+	*bucket = res;
+	shard->size += 1;
+	unlock_shard(shard);
 	return 1;
 }
 
-inline int remove_memblock(void* addr) {
-	struct memblock** actual = &allocated_mem;
-	while (*actual != NULL) {
-		if ((*actual)->addr == addr) {
-			struct memblock* temp = *actual;
-			*actual = (*actual)->next;
-			free(temp);
-			return 1;
+static int remove_memblock(void* addr) {
+	uint64_t hash = hash_addr(addr);
+	struct memshard* shard = shard_of(hash);
+	struct memblock* found = NULL;
+	lock_shard(shard);
+	if (shard->capacity != 0) {
+		struct memblock** actual = bucket_of(shard, hash);
+		while (*actual != NULL) {
+			if ((*actual)->addr == addr) {
+				found = *actual;
+				*actual = found->next;
+				shard->size -= 1;
+				break;
+			}
+			actual = &(*actual)->next;
 		}
-		actual = &(*actual)->next;
 	}
-	return 0;
+	unlock_shard(shard);
+	if (found == NULL)
+		return 0;
+	free(found);
+	return 1;
 }
 
 void* debug_malloc(size_t size, char* file, size_t line) {
@@ -82,15 +166,28 @@ void debug_free(void* ptr, char* file, size_t line) {
 }
 
 void print_allocated_mem(void) {
-	struct memblock* block = allocated_mem;
+	int none = 1;
 	printf("\nMemory allocated in the heap:\n\naddr\t\t\tsize\t\t\tfile\t\t\t\t\tline");
-	if (block == NULL)
-		printf("\n\nNONE\n");
-	else
-		while (block != NULL) {
-			printf("\n%p\t%zu\t%s\t%zu\n",
-				block->addr, block->size, block->file, block->line);
-			block = block->next;
+	for (size_t s = 0; s < SHARDS; s++) {
+		lock_shard(&shards[s]);
+		for (size_t i = 0; i < shards[s].capacity; i++) {
+			for (struct memblock* block = shards[s].buckets[i]; block != NULL; block = block->next) {
+				printf("\n%p\t%zu\t%s\t%zu\n",
+					block->addr, block->size, block->file, block->line);
+				none = 0;
+			}
 		}
+		unlock_shard(&shards[s]);
+	}
+	if (none)
+		printf("\n\nNONE\n");
 	printf("\n");
-}
\ No newline at end of file
+}
+
+#else
+
+// the release build doesn't track the allocations, there is nothing to report
+void print_allocated_mem(void) {
+}
+
+#endif
@@ -2,6 +2,12 @@
 #define MEMDEBUG_H_INCLUDED
 #include <stddef.h>
 
+void print_allocated_mem(void);
+
+// the allocations are tracked only in the builds with SSCRIPT_MEMDEBUG (make MEMDEBUG=1),
+// print_allocated_mem reports the blocks never freed and the frees of pointers never allocated
+#ifdef SSCRIPT_MEMDEBUG
+
 struct memblock {
 	void* addr;
 	char* file;
@@ -14,7 +20,6 @@ void* debug_malloc(size_t size, char* file, size_t line);
 void* debug_calloc(size_t nmemb, size_t size, char* file, size_t line);
 void* debug_realloc(void* ptr, size_t size, char* file, size_t line);
 void debug_free(void* ptr, char* file, size_t line);
-void print_allocated_mem(void);
 
 
 #define malloc(size) debug_malloc(size, __FILE__, __LINE__)
@@ -22,4 +27,6 @@ void print_allocated_mem(void);
 #define calloc(nmemb, size) debug_calloc(nmemb, size, __FILE__, __LINE__)
 #define realloc(ptr, size) debug_realloc(ptr, size, __FILE__, __LINE__)
 
+#endif
+
 #endif 
@@ -18,7 +18,9 @@ static struct Stack *init_Stack(const size_t capacity){
 inline void free_Stack(struct Stack *stack){
     for(size_t i = 0; i < stack->next; i++){
         if (stack->content[i].type == Instruction || stack->content[i].type == String) {
-            free(stack->content[i].val.instr);
+            release_Text(&stack->content[i]);
+            if (stack->content[i].type == Instruction)
+                release_Code(stack->content[i].code);
         }
         if (stack->content[i].type == InnerStack) {
             free_Stack(stack->content[i].val.stack);
@@ -34,7 +36,7 @@ static inline struct Environment *init_Environment(size_t capacity){
     struct Environment *res = malloc(sizeof(struct Environment));
     if(res == NULL)
         return NULL;
-    res->content = malloc(sizeof(struct EnvElem *) * capacity);
+    res->content = malloc(sizeof(struct Code *) * capacity);
     if(res->content == NULL)
         return NULL;
     res->capacity = capacity;
@@ -46,14 +48,7 @@ static inline struct Environment *init_Environment(size_t capacity){
 
 static inline void free_Environment(struct Environment *env){
     for (size_t i = 0; i < env->capacity; i++) {
-        struct EnvElem *elem = env->content[i];
-        while(elem != NULL){
-            struct EnvElem *temp = elem->next;
-            free(elem->key);
-            free(elem->value);
-            free(elem);
-            elem = temp;
-        }
+        release_Code(env->content[i]);
     }
     free(env->content);
     env->capacity = 0;
@@ -75,28 +70,56 @@ void free_PrgState(struct ProgramState *inter){
 struct ExceptionHandler *init_ExceptionHandler(){
     struct ExceptionHandler* try_buf = malloc(sizeof(struct ExceptionHandler));
     try_buf->not_exec = malloc(sizeof(char *) * BT_VEC_CAPACITY);
+    try_buf->bt_src = malloc(sizeof(struct BtSource) * BT_VEC_CAPACITY);
+    try_buf->bt_src[0].start = NULL;
+    try_buf->bt_src[0].end = NULL;
     try_buf->bt_size = 1;
     try_buf->bt_capacity = BT_VEC_CAPACITY;
+    try_buf->frames = malloc(sizeof(struct Frame) * FRAME_VEC_CAPACITY);
+    try_buf->fr_size = 0;
+    try_buf->fr_capacity = FRAME_VEC_CAPACITY;
     try_buf->openmemmap = malloc(sizeof(struct OpenMemMap *) * OM_VEC_CAPACITY);
     for(size_t i = 0; i < OM_VEC_CAPACITY; i++){
         try_buf->openmemmap[i] = NULL;
     }
     try_buf->stack_num = 0;
+    try_buf->arena.block = NULL;
+    try_buf->freemem = NULL;
     return try_buf;
 }
 
+static inline void free_Frames(struct ExceptionHandler *try_buf){
+    for(size_t i = 0; i < try_buf->fr_size; i++){
+        struct Frame *frame = &try_buf->frames[i];
+        release_Code(frame->code);
+        if(frame->dip){
+            if(frame->saved.type == Instruction || frame->saved.type == String){
+                release_Text(&frame->saved);
+                if(frame->saved.type == Instruction)
+                    release_Code(frame->saved.code);
+            }else if(frame->saved.type == InnerStack){
+                free_Stack(frame->saved.val.stack);
+            }
+        }
+    }
+    try_buf->fr_size = 0;
+}
+
 void reload_Exceptionhandler(struct ExceptionHandler *try_buf){
+    free_Frames(try_buf);
     for(size_t i = 0; i < OM_VEC_CAPACITY; i++){
         while(try_buf->openmemmap[i] != NULL){
             struct OpenMemMap *temp = try_buf->openmemmap[i];
             try_buf->openmemmap[i] =  try_buf->openmemmap[i]->next;
-            free(temp->openmem);
-            free(temp);
+            if(temp->openmem != NULL)
+                free(temp->openmem);
+            release_Code(temp->opencode);
         }
     }
-    try_buf->bt_capacity = BT_VEC_CAPACITY;
-    free(try_buf->not_exec);
-    try_buf->not_exec = malloc(sizeof(char *) * BT_VEC_CAPACITY);
+    try_buf->freemem = NULL;
+    reset_Arena(&try_buf->arena);
+    try_buf->bt_src[0].start = NULL;
+    try_buf->bt_src[0].end = NULL;
     try_buf->bt_size = 1;
     for (size_t i = 0; i < try_buf->stack_num; i++){
         if(try_buf->inject_err[i] != NULL){
@@ -111,15 +134,20 @@ void reload_Exceptionhandler(struct ExceptionHandler *try_buf){
 
 void free_ExceptionHandler(struct ExceptionHandler *try_buf){
     free(try_buf->not_exec);
+    free(try_buf->bt_src);
+    free_Frames(try_buf);
+    free(try_buf->frames);
     for(size_t i = 0; i < OM_VEC_CAPACITY; i++){
         while(try_buf->openmemmap[i] != NULL){
             struct OpenMemMap *temp = try_buf->openmemmap[i];
             try_buf->openmemmap[i] =  try_buf->openmemmap[i]->next;
-            free(temp->openmem);
-            free(temp);
+            if(temp->openmem != NULL)
+                free(temp->openmem);
+            release_Code(temp->opencode);
         }
     }
     free(try_buf->openmemmap);
+    free_Arena(&try_buf->arena);
     for (size_t i = 0; i < try_buf->stack_num; i++){
         if(try_buf->inject_err[i] != NULL){
             free_ExceptionHandler(try_buf->inject_err[i]);
@@ -131,6 +159,15 @@ void free_ExceptionHandler(struct ExceptionHandler *try_buf){
     free(try_buf);
 }
 
+// characters of not_exec[i] to print: a code shares its source with the one it's compiled from
+static int backtrace_Len(const struct ExceptionHandler *exc, size_t i){
+    uintptr_t at = (uintptr_t) exc->not_exec[i];
+    const struct BtSource *src = &exc->bt_src[i];
+    if(src->start != NULL && at >= (uintptr_t) src->start && at <= (uintptr_t) src->end)
+        return (int) (src->end - exc->not_exec[i]);
+    return (int) strlen(exc->not_exec[i]);
+}
+
 void print_Exception(struct ExceptionHandler *exc) {
     char *excstr;
     switch(exc->exit_value){
@@ -182,14 +219,14 @@ void print_Exception(struct ExceptionHandler *exc) {
         default:
             UNREACHABLE;
     }
-    printf("%s not executed: %12s\n", excstr, exc->not_exec[0]);
+    printf("%s not executed: %12.*s\n", excstr, backtrace_Len(exc, 0), exc->not_exec[0]);
     if(exc->bt_size > 1){
         printf("Backtrace:\n");
         char *tabs = malloc(sizeof(char) * exc->bt_size);
         tabs[0] = '\t';
         for(size_t i = 1; i < exc->bt_size; i++){
             tabs[i] = '\0';
-            printf("%s%s\n", tabs, exc->not_exec[i]);
+            printf("%s%.*s\n", tabs, backtrace_Len(exc, i), exc->not_exec[i]);
             tabs[i] = '\t';
         }
         free(tabs);
@@ -8,27 +8,55 @@
 #include "stack.h"
 #include "environment.h"
 #include "primitives.h"
+#include "arena.h"
 #include <setjmp.h>
 #include <string.h>
 
 struct OpenMemMap{
     char *openmem;
+    struct Code *opencode;
     struct OpenMemMap *next;
 };
 
+struct Instr;
+
+// call frame of the VM: it owns a reference to code
+struct Frame{
+    struct Code *code;
+    struct Instr *ret;
+    int dip;
+    struct StackElem saved;
+};
+
+// source of the code run by a backtrace level, not_exec is printed up to end when it points in it
+struct BtSource{
+    const char *start;
+    const char *end;
+};
+
 struct ExceptionHandler{
     jmp_buf buffer;
     uint32_t exit_value;
     char **not_exec;
+    struct BtSource *bt_src;
     size_t bt_size;
     size_t bt_capacity;
+    struct Frame *frames;
+    size_t fr_size;
+    size_t fr_capacity;
     struct OpenMemMap **openmemmap;
     struct ExceptionHandler **inject_err;
     size_t stack_num;
+    // temporaries of the evaluation running on this handler, reset by reload_Exceptionhandler,
+    // the nodes of openmemmap are taken from it and recycled through freemem
+    struct Arena arena;
+    struct OpenMemMap *freemem;
 };
 
 #define OM_VEC_CAPACITY 32
 #define BT_VEC_CAPACITY 32
+#define FRAME_VEC_CAPACITY 32
+#define INNER_STACK_CAPACITY 256
 
 #define TRY(EXCHANDLER) if (((EXCHANDLER)->exit_value = setjmp((EXCHANDLER)->buffer)) == 0)
 #define CATCH(EXCHANDLER, EXCNUM) else if ((EXCHANDLER)->exit_value == (EXCNUM))
@@ -66,6 +94,11 @@ typedef void (*br_operations)(struct ProgramState*, char*, size_t, struct Except
 
 typedef void (*num_operations)(struct ProgramState*, size_t, struct ExceptionHandler*);
 
+typedef void (*code_operations)(struct ProgramState*, struct Code*, struct ExceptionHandler*);
+
+struct Code *retain_Code(struct Code *code);
+void release_Code(struct Code *code);
+
 struct ProgramState init_PrgState(size_t stack_capacity, size_t env_capacity);
 void reload_Exceptionhandler(struct ExceptionHandler *try_buf);
 void free_PrgState(struct ProgramState *inter);
@@ -74,13 +107,43 @@ void free_Stack(struct Stack *stack);
 struct ExceptionHandler *init_ExceptionHandler();
 void free_ExceptionHandler(struct ExceptionHandler *exh);
 
+static inline void add_backtrace(struct ExceptionHandler *jbuff){
+    jbuff->bt_size += 1;
+    if(jbuff->bt_size >= jbuff->bt_capacity){
+        jbuff->bt_capacity *= 2;
+        jbuff->not_exec = realloc(jbuff->not_exec, sizeof(char *) * jbuff->bt_capacity);
+        jbuff->bt_src = realloc(jbuff->bt_src, sizeof(struct BtSource) * jbuff->bt_capacity);
+    }
+    jbuff->bt_src[jbuff->bt_size - 1] = jbuff->bt_src[jbuff->bt_size - 2];
+}
+
+static inline void remove_backtrace(struct ExceptionHandler *jbuff){
+    jbuff->bt_size -= 1;
+}
+
+static inline struct StackElem new_Stack(struct ExceptionHandler *jbuff){
+    struct StackElem elem;
+    elem.type = InnerStack;
+    elem.val.stack = malloc(sizeof(struct Stack));
+    if(elem.val.stack == NULL)
+        RAISE(jbuff, ProgramPanic);
+    elem.val.stack->capacity = INNER_STACK_CAPACITY;
+    elem.val.stack->next = 0;
+    elem.val.stack->content = malloc(sizeof(struct StackElem) * elem.val.stack->capacity);
+    if(elem.val.stack->content == NULL)
+        RAISE(jbuff, ProgramPanic);
+    return elem;
+}
+
 static inline void push_Stack(struct Stack *stack, const struct StackElem val, struct ExceptionHandler *jbuff){
     if(stack->next + 1 == stack->capacity){
         stack->capacity = stack->capacity << 1;
         struct StackElem *newmem = realloc(stack->content, stack->capacity * sizeof(struct StackElem));
         if(newmem == NULL){
-            if(val.type == Instruction)
-                free(val.val.instr);
+            if(val.type == Instruction){
+                release_Text(&val);
+                release_Code(val.code);
+            }
             RAISE(jbuff, ProgramPanic);
         }
         stack->content = newmem;
@@ -101,10 +164,9 @@ static inline void copy_Stack(struct Stack *dest, struct Stack *src, struct Exce
         switch(src->content[i].type){
             case String:
             case Instruction:
-                dest->content[i].val.instr = malloc(strlen(src->content[i].val.instr) + 1);
-                if (dest->content[i].val.instr == NULL)
-                    RAISE(jbuff, ProgramPanic);
-                memcpy(dest->content[i].val.instr, src->content[i].val.instr, strlen(src->content[i].val.instr) + 1);
+                copy_Text(&dest->content[i], &src->content[i]);
+                if (src->content[i].type == Instruction)
+                    dest->content[i].code = retain_Code(src->content[i].code);
                 break;
             case Type:
             case Boolean:
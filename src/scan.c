@@ -0,0 +1,180 @@
+#include "scan.h"
+#include <stdlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define SIMD_SCAN
+#endif
+
+#include "memdebug.h"
+
+// classes of 64 characters, bit i is the character i
+struct Chunk{
+    uint64_t structural;
+    uint64_t blank;
+    uint64_t stop;
+};
+
+#define IS_BLANK(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n' || (c) == '\0')
+#define IS_STRUCTURAL(c) ((c) == '[' || (c) == ']' || (c) == '{' || (c) == '}' || (c) == '(' || (c) == ')' || (c) == '"')
+
+static inline struct Chunk classify_Scalar(const char *src, size_t n){
+    struct Chunk res = {0, 0, 0};
+    for(size_t i = 0; i < n; i++){
+        char c = src[i];
+        uint64_t bit = (uint64_t) 1 << i;
+        if(IS_STRUCTURAL(c))
+            res.structural |= bit;
+        if(IS_BLANK(c))
+            res.blank |= bit;
+        if(IS_BLANK(c) || c == '(' || (c >= '0' && c <= '9'))
+            res.stop |= bit;
+    }
+    return res;
+}
+
+#ifdef SIMD_SCAN
+
+#define EQ128(v, c) _mm_cmpeq_epi8((v), _mm_set1_epi8(c))
+
+static inline struct Chunk classify_SSE2(const char *src){
+    struct Chunk res = {0, 0, 0};
+    for(size_t k = 0; k < 4; k++){
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + 16 * k));
+        __m128i round = EQ128(v, '(');
+        __m128i brackets = _mm_or_si128(_mm_or_si128(EQ128(v, '['), EQ128(v, ']')), _mm_or_si128(EQ128(v, '{'), EQ128(v, '}')));
+        __m128i structural = _mm_or_si128(brackets, _mm_or_si128(_mm_or_si128(round, EQ128(v, ')')), EQ128(v, '"')));
+        __m128i spaces = _mm_or_si128(_mm_or_si128(EQ128(v, ' '), EQ128(v, '\t')), _mm_or_si128(EQ128(v, '\r'), EQ128(v, '\n')));
+        __m128i blank = _mm_or_si128(spaces, EQ128(v, '\0'));
+        // v - '0' is at most 9 only for the digits
+        __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+        digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+        __m128i stop = _mm_or_si128(_mm_or_si128(blank, round), digit);
+        res.structural |= (uint64_t) (uint16_t) _mm_movemask_epi8(structural) << (16 * k);
+        res.blank |= (uint64_t) (uint16_t) _mm_movemask_epi8(blank) << (16 * k);
+        res.stop |= (uint64_t) (uint16_t) _mm_movemask_epi8(stop) << (16 * k);
+    }
+    return res;
+}
+
+#define EQ256(v, c) _mm256_cmpeq_epi8((v), _mm256_set1_epi8(c))
+
+__attribute__((target("avx2")))
+static struct Chunk classify_AVX2(const char *src){
+    struct Chunk res = {0, 0, 0};
+    for(size_t k = 0; k < 2; k++){
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + 32 * k));
+        __m256i round = EQ256(v, '(');
+        __m256i brackets = _mm256_or_si256(_mm256_or_si256(EQ256(v, '['), EQ256(v, ']')), _mm256_or_si256(EQ256(v, '{'), EQ256(v, '}')));
+        __m256i structural = _mm256_or_si256(brackets, _mm256_or_si256(_mm256_or_si256(round, EQ256(v, ')')), EQ256(v, '"')));
+        __m256i spaces = _mm256_or_si256(_mm256_or_si256(EQ256(v, ' '), EQ256(v, '\t')), _mm256_or_si256(EQ256(v, '\r'), EQ256(v, '\n')));
+        __m256i blank = _mm256_or_si256(spaces, EQ256(v, '\0'));
+        __m256i digit = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+        digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+        __m256i stop = _mm256_or_si256(_mm256_or_si256(blank, round), digit);
+        res.structural |= (uint64_t) (uint32_t) _mm256_movemask_epi8(structural) << (32 * k);
+        res.blank |= (uint64_t) (uint32_t) _mm256_movemask_epi8(blank) << (32 * k);
+        res.stop |= (uint64_t) (uint32_t) _mm256_movemask_epi8(stop) << (32 * k);
+    }
+    return res;
+}
+
+#endif
+
+// the open characters are chained through match until they are closed
+struct OpenChains{
+    size_t square;
+    size_t curly;
+    size_t round;
+    size_t quote;
+};
+
+static inline void match_Structural(const char *src, size_t *match, struct OpenChains *open, size_t i){
+    size_t prev;
+    switch(src[i]){
+        case '[':
+            match[i] = open->square;
+            open->square = i;
+            break;
+        case ']':
+            if(open->square != SIZE_MAX){
+                prev = match[open->square];
+                match[open->square] = i - open->square;
+                open->square = prev;
+            }
+            break;
+        case '{':
+            match[i] = open->curly;
+            open->curly = i;
+            break;
+        case '}':
+            if(open->curly != SIZE_MAX){
+                prev = match[open->curly];
+                match[open->curly] = i - open->curly;
+                open->curly = prev;
+            }
+            break;
+        case '(':
+            match[i] = open->round;
+            open->round = i;
+            break;
+        case ')':
+            while(open->round != SIZE_MAX){
+                prev = match[open->round];
+                match[open->round] = i - open->round;
+                open->round = prev;
+            }
+            break;
+        case '"':
+            if(open->quote != SIZE_MAX)
+                match[open->quote] = i - open->quote;
+            match[i] = NO_MATCH;
+            open->quote = i;
+            break;
+    }
+}
+
+// Only the structural characters are visited: match is left uninitialized for the others, the
+// tokenizers read it only where a '[', '{', '"' or '(' is. The chunk that doesn't fit in the source
+// is classified by the scalar loop.
+struct SourceIndex index_Source(const char *src, size_t len){
+    struct SourceIndex index = {NULL, NULL, NULL, 0};
+    size_t words = len / 64 + 1;
+    char *mem = malloc(sizeof(size_t) * (len + 1) + sizeof(uint64_t) * words * 2);
+    if(mem == NULL)
+        return index;
+    index.match = (size_t *) mem;
+    index.blank = (uint64_t *) (mem + sizeof(size_t) * (len + 1));
+    index.stop = index.blank + words;
+#ifdef SIMD_SCAN
+    int avx2 = __builtin_cpu_supports("avx2");
+#endif
+    struct OpenChains open = {SIZE_MAX, SIZE_MAX, SIZE_MAX, SIZE_MAX};
+    for(size_t w = 0; w < words; w++){
+        size_t start = w * 64;
+        struct Chunk chunk;
+#ifdef SIMD_SCAN
+        if(start + 64 <= len)
+            chunk = avx2 ? classify_AVX2(src + start) : classify_SSE2(src + start);
+        else
+#endif
+            chunk = classify_Scalar(src + start, start + 64 <= len ? 64 : len - start);
+        index.blank[w] = chunk.blank;
+        index.stop[w] = chunk.stop;
+        for(uint64_t bits = chunk.structural; bits != 0; bits &= bits - 1)
+            match_Structural(src, index.match, &open, start + lowest_Bit(bits));
+    }
+    size_t unclosed[] = {open.square, open.curly, open.round};
+    for(size_t k = 0; k < sizeof(unclosed) / sizeof(unclosed[0]); k++){
+        for(size_t i = unclosed[k]; i != SIZE_MAX; ){
+            size_t prev = index.match[i];
+            index.match[i] = NO_MATCH;
+            i = prev;
+        }
+    }
+    return index;
+}
+
+void free_SourceIndex(struct SourceIndex *index){
+    free(index->match);
+}
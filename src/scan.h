@@ -0,0 +1,57 @@
+#ifndef SSCRIPT_SCAN_H
+#define SSCRIPT_SCAN_H
+#include <stddef.h>
+#include <stdint.h>
+
+#define NO_MATCH 0
+
+// Structural index of a source, built by index_Source in one pass that classifies 64 characters at a time.
+// match[i] is the distance from the '[', '{', '"' or '(' at i to the character that closes it, NO_MATCH
+// when it's not closed, it's not set for the other characters. Brackets nest only with the ones of
+// their kind, a '"' is closed by the next '"' and a '(' by the next ')', like the tokenizers scan them.
+// Bit i of blank is set when src[i] is an indentation character, bit i of stop when a generic token
+// ends at src[i]: an indentation character, a '(' or a digit.
+// A slice is the index of a part of the source: match starts at the part, base is its offset in the bitmaps.
+struct SourceIndex{
+	size_t *match;
+	uint64_t *blank;
+	uint64_t *stop;
+	size_t base;
+};
+
+// match is NULL when the memory can't be allocated, only the whole index is freed
+struct SourceIndex index_Source(const char *src, size_t len);
+void free_SourceIndex(struct SourceIndex *index);
+
+static inline struct SourceIndex slice_Index(const struct SourceIndex *index, size_t offset){
+	struct SourceIndex slice = {index->match + offset, index->blank, index->stop, index->base + offset};
+	return slice;
+}
+
+static inline size_t lowest_Bit(uint64_t word){
+#ifdef __GNUC__
+	return (size_t) __builtin_ctzll(word);
+#else
+	size_t n = 0;
+	while((word & 1) == 0){
+		word >>= 1;
+		n += 1;
+	}
+	return n;
+#endif
+}
+
+// first position from from to to (excluded) of the slice whose bit in map is equal to set, to if there is none
+static inline size_t next_Bit(const struct SourceIndex *index, const uint64_t *map, int set, size_t from, size_t to){
+	size_t end = index->base + to;
+	for(size_t p = index->base + from; p < end; p = (p / 64 + 1) * 64){
+		uint64_t word = (set ? map[p / 64] : ~map[p / 64]) >> (p % 64);
+		if(word != 0){
+			p += lowest_Bit(word);
+			return p < end ? p - index->base : to;
+		}
+	}
+	return to;
+}
+
+#endif
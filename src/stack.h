@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
 
 #ifdef __GNUC__
 	#define UNREACHABLE __builtin_unreachable()
@@ -33,18 +35,127 @@ enum ElemType{
     InnerStack
 };
 
+// The text of a String or an Instruction on the heap. It's shared by the copies of the element and
+// it's immutable while it's shared: grow_Text copies it before changing it.
+struct Text{
+    atomic_size_t refcount;
+    size_t len;
+    char data[];
+};
+
 union ElemVal{
-    char *instr;
+    struct Text *text;
+    char small[sizeof(int64_t)];
     int64_t ival;
     double fval;
     struct Stack *stack;
 };
 
+struct Code;
+
+// a text shorter than SMALL_TEXT is stored in val.small: issmall is set and smalllen is its length
 struct StackElem{
     enum ElemType type;
+    uint16_t issmall;
+    uint16_t smalllen;
     union ElemVal val;
+    struct Code *code;
 };
 
+#define SMALL_TEXT sizeof(union ElemVal)
+
+static inline char *text_Elem(struct StackElem *elem){
+    return elem->issmall ? elem->val.small : elem->val.text->data;
+}
+
+static inline size_t text_Len(const struct StackElem *elem){
+    return elem->issmall ? elem->smalllen : elem->val.text->len;
+}
+
+static inline struct Text *retain_Text(struct Text *text){
+    atomic_fetch_add_explicit(&text->refcount, 1, memory_order_relaxed);
+    return text;
+}
+
+static inline void drop_Text(struct Text *text){
+    if(atomic_fetch_sub_explicit(&text->refcount, 1, memory_order_acq_rel) == 1)
+        free(text);
+}
+
+static inline void release_Text(const struct StackElem *elem){
+    if(!elem->issmall)
+        drop_Text(elem->val.text);
+}
+
+// room for a text of len characters in elem, NULL when the memory can't be allocated
+static inline char *alloc_Text(struct StackElem *elem, size_t len){
+    if(len < SMALL_TEXT){
+        elem->issmall = 1;
+        elem->smalllen = len;
+        elem->val.small[len] = '\0';
+        return elem->val.small;
+    }
+    elem->issmall = 0;
+    elem->val.text = malloc(sizeof(struct Text) + len + 1);
+    if(elem->val.text == NULL)
+        return NULL;
+    atomic_init(&elem->val.text->refcount, 1);
+    elem->val.text->len = len;
+    elem->val.text->data[len] = '\0';
+    return elem->val.text->data;
+}
+
+// copies len characters of text in elem, returns 0 when the memory can't be allocated
+static inline int set_Text(struct StackElem *elem, const char *text, size_t len){
+    char *dst = alloc_Text(elem, len);
+    if(dst == NULL)
+        return 0;
+    memcpy(dst, text, len);
+    return 1;
+}
+
+// room for len characters in the text of elem keeping the ones it has, NULL when the memory can't be
+// allocated. A shared text is copied, the other copies of the element still see the old one.
+static inline char *grow_Text(struct StackElem *elem, size_t len){
+    struct Text *grown;
+    if(elem->issmall){
+        if(len < SMALL_TEXT){
+            elem->smalllen = len;
+            elem->val.small[len] = '\0';
+            return elem->val.small;
+        }
+        grown = malloc(sizeof(struct Text) + len + 1);
+        if(grown == NULL)
+            return NULL;
+        memcpy(grown->data, elem->val.small, elem->smalllen);
+        elem->issmall = 0;
+    }else if(atomic_load_explicit(&elem->val.text->refcount, memory_order_acquire) == 1){
+        grown = realloc(elem->val.text, sizeof(struct Text) + len + 1);
+        if(grown == NULL)
+            return NULL;
+    }else{
+        grown = malloc(sizeof(struct Text) + len + 1);
+        if(grown == NULL)
+            return NULL;
+        memcpy(grown->data, elem->val.text->data, elem->val.text->len < len ? elem->val.text->len : len);
+        release_Text(elem);
+    }
+    atomic_init(&grown->refcount, 1);
+    grown->len = len;
+    grown->data[len] = '\0';
+    elem->val.text = grown;
+    return grown->data;
+}
+
+// dst gets the text of src: an inline text is copied with the element, one on the heap is shared
+static inline void copy_Text(struct StackElem *dst, const struct StackElem *src){
+    dst->issmall = src->issmall;
+    dst->smalllen = src->smalllen;
+    dst->val = src->val;
+    if(!src->issmall)
+        retain_Text(src->val.text);
+}
+
 struct Stack{
     struct StackElem *content;
     size_t capacity;
@@ -5,10 +5,10 @@ static inline void print_InnerStack(struct Stack *stack){
     for(size_t i = 0; i< stack->next; i++){
         switch (stack->content[i].type){
             case Instruction:
-                printf("[ %s ] ", stack->content[i].val.instr);
+                printf("[ %s ] ", text_Elem(&stack->content[i]));
                 break;
             case String:
-                printf("\"%s\" ", stack->content[i].val.instr);
+                printf("\"%s\" ", text_Elem(&stack->content[i]));
                 break;
             case Integer:
                 printf("%ld ", stack->content[i].val.ival);
@@ -39,10 +39,10 @@ static inline void print_single(struct Stack *stack, size_t num){
     switch (stack->content[stack->next - num].type)
     {
     case Instruction:
-        printf("[ %s ]\n", stack->content[stack->next - num].val.instr);
+        printf("[ %s ]\n", text_Elem(&stack->content[stack->next - num]));
         break;
     case String:
-        printf("\"%s\"\n", stack->content[stack->next - num].val.instr);
+        printf("\"%s\"\n", text_Elem(&stack->content[stack->next - num]));
         break;
     case Integer:
         printf("%ld\n", stack->content[stack->next - num].val.ival);
@@ -77,21 +77,16 @@ void print_stack(struct ProgramState* state, size_t num_elem) {
 void op_dup(struct ProgramState *state, struct ExceptionHandler *jbuff){
     if(state->stack->next == 0)
         RAISE(jbuff, StackUnderflow);
-    struct StackElem copy;
-    copy.type = state->stack->content[state->stack->next - 1].type;
+    struct StackElem copy = state->stack->content[state->stack->next - 1];
     if (copy.type == Instruction || copy.type == String) {
-        size_t srclen = strlen(state->stack->content[state->stack->next - 1].val.instr) + 1;
-        copy.val.instr = malloc(srclen);
-        if (copy.val.instr == NULL)
-            RAISE(jbuff, ProgramPanic);
-        memcpy(copy.val.instr, state->stack->content[state->stack->next - 1].val.instr, srclen);
+        copy_Text(&copy, &state->stack->content[state->stack->next - 1]);
+        if (copy.type == Instruction)
+            retain_Code(copy.code);
     }else if(copy.type == InnerStack){
         copy.val.stack = malloc(sizeof(struct Stack));
         if(copy.val.stack == NULL)
             RAISE(jbuff, ProgramPanic);
         copy_Stack(copy.val.stack, state->stack->content[state->stack->next - 1].val.stack, jbuff);
-    }else {
-        copy.val = state->stack->content[state->stack->next - 1].val;
     }
     push_Stack(state->stack, copy, jbuff);
 }
@@ -101,7 +96,11 @@ void op_top(struct ProgramState *state, struct ExceptionHandler *jbuff){
         RAISE(jbuff, StackUnderflow);
     struct StackElem copy;
     copy.type = state->stack->content[0].type;
-    copy.val = state->stack->content[0].val;
+    if (copy.type == Instruction || copy.type == String)
+        copy_Text(&copy, &state->stack->content[0]);
+    else
+        copy.val = state->stack->content[0].val;
+    copy.code = NULL;
     push_Stack(state->stack, copy, jbuff);
 }
 
@@ -120,18 +119,22 @@ void op_drop(struct ProgramState *state, struct ExceptionHandler *jbuff){
     if(state->stack->next == 0)
         RAISE(jbuff, StackUnderflow);
     state->stack->next -= 1;
-    if(state->stack->content[state->stack->next].type == Instruction || state->stack->content[state->stack->next].type == String)
-        free(state->stack->content[state->stack->next].val.instr);
-    else if(state->stack->content[state->stack->next].type == InnerStack){
+    if(state->stack->content[state->stack->next].type == Instruction || state->stack->content[state->stack->next].type == String){
+        release_Text(&state->stack->content[state->stack->next]);
+        if(state->stack->content[state->stack->next].type == Instruction)
+            release_Code(state->stack->content[state->stack->next].code);
+    }else if(state->stack->content[state->stack->next].type == InnerStack){
         free_Stack(state->stack->content[state->stack->next].val.stack);
     }
 }
 
 void op_clear(struct ProgramState *state, struct ExceptionHandler *jbuff){
     for(size_t i = 0; i < state->stack->next; i++){
-        if(state->stack->content[i].type == Instruction || state->stack->content[i].type == String)
-            free(state->stack->content[i].val.instr);
-        else if(state->stack->content[i].type == InnerStack)
+        if(state->stack->content[i].type == Instruction || state->stack->content[i].type == String){
+            release_Text(&state->stack->content[i]);
+            if(state->stack->content[i].type == Instruction)
+                release_Code(state->stack->content[i].code);
+        }else if(state->stack->content[i].type == InnerStack)
             free_Stack(state->stack->content[i].val.stack);
     }
     state->stack->next = 0;
@@ -157,90 +160,83 @@ void op_quote(struct ProgramState *state, struct ExceptionHandler *jbuff) {
     size_t finallen;
     char *resstr;
     int result;
+    union ElemVal number;
     switch (state->stack->content[resindex].type)
     {
     case String:
-        finallen = strlen(state->stack->content[resindex].val.instr) + 3;
-        resstr = malloc(finallen);
+        finallen = text_Len(&state->stack->content[resindex]) + 2;
+        resstr = grow_Text(&state->stack->content[resindex], finallen);
         if (resstr == NULL) {
             RAISE(jbuff, ProgramPanic);
         } else {
+            memmove(resstr + 1, resstr, finallen - 2);
             resstr[0] = '"';
-            strcpy(resstr + 1, state->stack->content[resindex].val.instr);
-            resstr[finallen - 2] = '"';
-            resstr[finallen - 1] = '\0';
-            free(state->stack->content[resindex].val.instr);
-            state->stack->content[resindex].val.instr = resstr;
+            resstr[finallen - 1] = '"';
             state->stack->content[resindex].type = Instruction;
+            state->stack->content[resindex].code = NULL;
         }
         break;
     case Instruction:
-        finallen = strlen(state->stack->content[resindex].val.instr) + 3;
-        resstr = malloc(finallen);
+        finallen = text_Len(&state->stack->content[resindex]) + 2;
+        resstr = grow_Text(&state->stack->content[resindex], finallen);
         if (resstr == NULL) {
             RAISE(jbuff, ProgramPanic);
         } else {
-            strcpy(resstr + 1, state->stack->content[resindex].val.instr);
+            memmove(resstr + 1, resstr, finallen - 2);
             resstr[0] = '[';
-            resstr[finallen - 2] = ']';
-            resstr[finallen - 1] = '\0';
-            free(state->stack->content[resindex].val.instr);
-            state->stack->content[resindex].val.instr = resstr;
+            resstr[finallen - 1] = ']';
+            release_Code(state->stack->content[resindex].code);
+            state->stack->content[resindex].code = NULL;
         }
         break;
     case Integer:
-        finallen = (int) log10((double)state->stack->content[resindex].val.ival + 1) + 1 + (state->stack->content[resindex].val.ival < 0);
-        resstr = malloc(finallen + 3);
+        number = state->stack->content[resindex].val;
+        result = snprintf(NULL, 0, "%ld", number.ival);
+        resstr = alloc_Text(&state->stack->content[resindex], result);
         if (resstr == NULL) {
             RAISE(jbuff, ProgramPanic);
         } else {
-            snprintf(resstr, finallen + 3, "%ld", state->stack->content[resindex].val.ival);
-            state->stack->content[resindex].val.instr = resstr;
+            snprintf(resstr, result + 1, "%ld", number.ival);
             state->stack->content[resindex].type = Instruction;
+            state->stack->content[resindex].code = NULL;
         }
         break;
     case Floating:
-        result = (int) log10(state->stack->content[resindex].val.fval + 1) + 1 + (state->stack->content[resindex].val.ival < 0);
-        result += 20 / (1 + result);
-        char *resstr = malloc(result + 3);
+        number = state->stack->content[resindex].val;
+        result = snprintf(NULL, 0, "%lf", number.fval);
+        resstr = alloc_Text(&state->stack->content[resindex], result);
         if (resstr == NULL) {
             RAISE(jbuff, ProgramPanic);
         } else {
-            snprintf(resstr, result + 3, "%lf", state->stack->content[resindex].val.fval);
-            state->stack->content[resindex].val.instr = resstr;
+            snprintf(resstr, result + 1, "%lf", number.fval);
             state->stack->content[resindex].type = Instruction;
+            state->stack->content[resindex].code = NULL;
         }
         break;
     case Boolean:
         result = state->stack->content[resindex].val.ival;
-        state->stack->content[resindex].val.instr = malloc(6 - result);
-        if (state->stack->content[resindex].val.instr == NULL) {
+        if (!set_Text(&state->stack->content[resindex], BOOL[result], 5 - result)) {
             RAISE(jbuff, ProgramPanic);
         } else {
-            strncpy(state->stack->content[resindex].val.instr, BOOL[result], 5 - result);
-            state->stack->content[resindex].val.instr[6 - result] = '\0';
             state->stack->content[resindex].type = Instruction;
+            state->stack->content[resindex].code = NULL;
         }
         break;
     case None:
-        state->stack->content[resindex].val.instr = malloc(5);
-        if (state->stack->content[resindex].val.instr == NULL) {
+        if (!set_Text(&state->stack->content[resindex], NONE, 4)) {
             RAISE(jbuff, ProgramPanic);
         } else {
-            strncpy(state->stack->content[resindex].val.instr, NONE, 4);
-            state->stack->content[resindex].val.instr[4] = '\0';
             state->stack->content[resindex].type = Instruction;
+            state->stack->content[resindex].code = NULL;
         }
         break;
     case Type:
         result = state->stack->content[resindex].val.ival;
-        state->stack->content[resindex].val.instr = malloc(TYPES_LEN[result] + 1);
-        if (state->stack->content[resindex].val.instr == NULL) {
+        if (!set_Text(&state->stack->content[resindex], TYPES[result], TYPES_LEN[result])) {
             RAISE(jbuff, ProgramPanic);
         } else {
-            strncpy(state->stack->content[resindex].val.instr, TYPES[result], TYPES_LEN[result]);
-            state->stack->content[resindex].val.instr[TYPES_LEN[result]] = '\0';
             state->stack->content[resindex].type = Instruction;
+            state->stack->content[resindex].code = NULL;
         }
     break;
     case InnerStack:
@@ -257,17 +253,20 @@ void op_compose(struct ProgramState *state, struct ExceptionHandler *jbuff){
     state->stack->next -= 1;
     if((state->stack->content[state->stack->next].type == Instruction && state->stack->content[state->stack->next - 1].type == Instruction)
         || (state->stack->content[state->stack->next].type == String && state->stack->content[state->stack->next - 1].type == String)){
-        size_t lensecond = strlen(state->stack->content[state->stack->next].val.instr);
-        size_t lenfirst =  strlen(state->stack->content[state->stack->next - 1].val.instr);
-        char *composte = realloc(state->stack->content[state->stack->next - 1].val.instr, lensecond + lenfirst + 2);
+        size_t lensecond = text_Len(&state->stack->content[state->stack->next]);
+        size_t lenfirst =  text_Len(&state->stack->content[state->stack->next - 1]);
+        char *composte = grow_Text(&state->stack->content[state->stack->next - 1], lensecond + lenfirst + 1);
         if(composte == NULL){
             RAISE(jbuff, ProgramPanic);
         }
-        state->stack->content[state->stack->next - 1].val.instr = composte;
-        state->stack->content[state->stack->next - 1].val.instr[lenfirst] = ' ';
-        strcpy(state->stack->content[state->stack->next - 1].val.instr + lenfirst + 1, state->stack->content[state->stack->next].val.instr);
-        free(state->stack->content[state->stack->next].val.instr);
-        state->stack->content[state->stack->next - 1].val.instr[lensecond + lenfirst + 1] = '\0';
+        composte[lenfirst] = ' ';
+        memcpy(composte + lenfirst + 1, text_Elem(&state->stack->content[state->stack->next]), lensecond);
+        release_Text(&state->stack->content[state->stack->next]);
+        if(state->stack->content[state->stack->next].type == Instruction){
+            release_Code(state->stack->content[state->stack->next].code);
+            release_Code(state->stack->content[state->stack->next - 1].code);
+            state->stack->content[state->stack->next - 1].code = NULL;
+        }
     }else{
         state->stack->next += 1;
         RAISE(jbuff, InvalidOperands);
@@ -309,22 +308,17 @@ void numop_dig(struct ProgramState* state, size_t num, struct ExceptionHandler*
 void numop_dup(struct ProgramState *state, size_t num, struct ExceptionHandler *jbuff){
     if(num >= state->stack->next)
         RAISE(jbuff, StackUnderflow);
-    struct StackElem copy;
     size_t index = state->stack->next - 1 - num;
-    copy.type = state->stack->content[index].type;
+    struct StackElem copy = state->stack->content[index];
     if (copy.type == Instruction || copy.type == String) {
-        size_t srclen = strlen(state->stack->content[index].val.instr) + 1;
-        copy.val.instr = malloc(srclen);
-        if (copy.val.instr == NULL)
-            RAISE(jbuff, ProgramPanic);
-        memcpy(copy.val.instr, state->stack->content[index].val.instr, srclen);
+        copy_Text(&copy, &state->stack->content[index]);
+        if (copy.type == Instruction)
+            retain_Code(copy.code);
     }else if(copy.type == InnerStack){
         copy.val.stack = malloc(sizeof(struct Stack));
         if(copy.val.stack == NULL)
             RAISE(jbuff, ProgramPanic);
         copy_Stack(copy.val.stack, state->stack->content[state->stack->next - 1].val.stack, jbuff);
-    }else {
-        copy.val = state->stack->content[index].val;
     }
     push_Stack(state->stack, copy, jbuff);
 }
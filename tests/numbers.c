@@ -0,0 +1,68 @@
+// Reads every literal of a corpus with the tokenizer of the interpreter and checks the length and
+// the value of the numeric token it gives, see tests/numbers.txt for the format of the corpus.
+#include <stdio.h>
+#include <inttypes.h>
+#include "../src/interpreter.h"
+
+#define LINE_SIZE 256
+
+static int check_Literal(char *literal, size_t length, const char *type, const char *value, struct ExceptionHandler *jbuff){
+    size_t len = strlen(literal);
+    struct SourceIndex index = index_Source(literal, len);
+    if(index.match == NULL)
+        return 0;
+    struct Token token;
+    size_t pos = 0;
+    int ok = next_token(literal, len, &pos, &token, &index, jbuff) && pos == length;
+    if(strcmp(type, "int") == 0){
+        int64_t expected = strtoll(value, NULL, 10);
+        ok = ok && token.type == IntegerToken && token.info.integer == expected;
+        if(!ok)
+            printf("%s: expected %zu characters, integer %" PRId64 "\n", literal, length, expected);
+    }else{
+        double expected = strtod(value, NULL);
+        ok = ok && token.type == DecimalToken && memcmp(&token.info.decimal, &expected, sizeof(double)) == 0;
+        if(!ok)
+            printf("%s: expected %zu characters, decimal %a\n", literal, length, expected);
+    }
+    if(!ok){
+        if(token.type == IntegerToken)
+            printf("\tread %zu characters, integer %" PRId64 "\n", pos, token.info.integer);
+        else if(token.type == DecimalToken)
+            printf("\tread %zu characters, decimal %a\n", pos, token.info.decimal);
+        else
+            printf("\tread %zu characters, not a number\n", pos);
+    }
+    free_SourceIndex(&index);
+    return ok;
+}
+
+int main(int argc, char **argv){
+    if(argc != 2){
+        printf("usage: %s corpus\n", argv[0]);
+        return 2;
+    }
+    FILE *corpus = fopen(argv[1], "r");
+    if(corpus == NULL){
+        printf("can't open %s\n", argv[1]);
+        return 2;
+    }
+    struct ExceptionHandler *jbuff = init_ExceptionHandler();
+    char line[LINE_SIZE], literal[LINE_SIZE], type[LINE_SIZE], value[LINE_SIZE];
+    size_t length, checked = 0, failed = 0;
+    while(fgets(line, LINE_SIZE, corpus) != NULL){
+        if(line[0] == '#' || line[0] == '\n')
+            continue;
+        if(sscanf(line, "%255s %zu %255s %255s", literal, &length, type, value) != 4){
+            printf("malformed line: %s", line);
+            failed += 1;
+            continue;
+        }
+        checked += 1;
+        failed += !check_Literal(literal, length, type, value, jbuff);
+    }
+    fclose(corpus);
+    free_ExceptionHandler(jbuff);
+    printf("%s: %zu literals, %zu failed\n", argv[1], checked, failed);
+    return failed != 0;
+}
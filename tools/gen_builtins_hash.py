@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Generates src/builtins_hash.h, the perfect hash tables of the builtin instructions.
+
+The keys are read from the INSTRUCTIONS, BRACKETS_INSTR and NUMBERED_INSTR arrays of
+src/interpreter.c: run "make builtins" after changing them.
+"""
+import random
+import re
+import sys
+
+SRC = "src/interpreter.c"
+OUT = "src/builtins_hash.h"
+
+TABLES = (
+    # prefix, array, slots
+    ("OP", "INSTRUCTIONS", 256),
+    ("BROP", "BRACKETS_INSTR", 32),
+    ("NUMOP", "NUMBERED_INSTR", 8),
+)
+
+
+def read_keys(src, name):
+    match = re.search(r"char\s*\*\s*" + name + r"\[\]\s*=\s*\{(.*?)\};", src, re.S)
+    if match is None:
+        sys.exit("array " + name + " not found in " + SRC)
+    return re.findall(r'"([^"]*)"', match.group(1))
+
+
+def builtin_hash(key, mul, mask):
+    key = key.encode()
+    return (key[0] * mul[0] + key[len(key) // 2] * mul[1] + key[-1] * mul[2] + len(key) * mul[3]) & mask
+
+
+def find_multipliers(keys, slots):
+    rand = random.Random(0)
+    for _ in range(10000000):
+        mul = [rand.randrange(1, slots) for _ in range(4)]
+        if len({builtin_hash(key, mul, slots - 1) for key in keys}) == len(keys):
+            return mul
+    sys.exit("no perfect hash found, increase the number of slots")
+
+
+def main():
+    with open(SRC) as file:
+        src = file.read()
+    out = [
+        "// Generated by tools/gen_builtins_hash.py from the builtin tables of interpreter.c, do not edit.",
+        "#ifndef SSCRIPT_BUILTINS_HASH_H",
+        "#define SSCRIPT_BUILTINS_HASH_H",
+        "",
+    ]
+    for prefix, array, slots in TABLES:
+        keys = read_keys(src, array)
+        mul = find_multipliers(keys, slots)
+        slot = [0] * slots
+        for i, key in enumerate(keys):
+            slot[builtin_hash(key, mul, slots - 1)] = i + 1
+        out.append("#define %s_HASHED_SIZE %d" % (prefix, len(keys)))
+        for name, value in zip("ABCD", mul):
+            out.append("#define %s_HASH_%s %du" % (prefix, name, value))
+        out.append("#define %s_HASH_MASK %du" % (prefix, slots - 1))
+        out.append("// index + 1 in %s of the key hashed in every slot, 0 if the slot is empty" % array)
+        out.append("static const unsigned char %s_SLOT[%d] = {" % (prefix, slots))
+        for i in range(0, slots, 16):
+            out.append("        " + ", ".join("%2d" % v for v in slot[i:i + 16]) + ",")
+        out.append("};")
+        out.append("")
+    out.append("#endif //SSCRIPT_BUILTINS_HASH_H")
+    with open(OUT, "w") as file:
+        file.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()